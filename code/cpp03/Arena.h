@@ -0,0 +1,163 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>   // std::size_t
+#include <cstdlib>   // std::malloc, std::free
+#include <new>       // std::bad_alloc
+
+
+/**
+ * Alignment requirement of T (C++03 has no alignof): a T placed right
+ * after a char is padded to T's alignment, and sizeof(T) is a multiple
+ * of it, so the struct is exactly one alignment bigger than T. Unlike
+ * offsetof, sizeof is also defined for non-POD T (e.g. Pos2d, which
+ * has constructors).
+ */
+template <typename T>
+struct AlignmentOf {
+  struct Probe {
+    char c;
+    T t;
+  };
+  static const std::size_t value = sizeof(Probe) - sizeof(T);
+};
+
+
+/**
+ * A bump ("arena") allocator
+ *
+ * Memory is handed out from large blocks by advancing a pointer, so
+ * objects allocated one after the other lie next to each other in
+ * memory. There is no per-object free: Release() gives back all
+ * blocks at once, and with a block big enough for everything (see the
+ * constructor) that is a single free() call.
+ *
+ * Objects are not destroyed by the arena. Only put objects in it
+ * whose destructor does nothing (e.g. plain structs like Pos2d), or
+ * call their destructors yourself.
+ */
+class Arena {
+public:
+  /// The first block holds "capacity" bytes; each further block is
+  /// twice as big as the previous one
+  explicit Arena(std::size_t capacity = 4096)
+  : head_(0), next_capacity_(capacity > 0 ? capacity : 1)
+  { }
+
+  ~Arena()
+  {
+    Release();
+  }
+
+  /// Uninitialized, suitably aligned memory for "count" objects of
+  /// type T; construct them with placement new
+  template <typename T>
+  T* Allocate(std::size_t count = 1)
+  {
+    return static_cast<T*>(Allocate(count * sizeof(T),
+                                    AlignmentOf<T>::value));
+  }
+
+  void* Allocate(std::size_t bytes, std::size_t alignment)
+  {
+    std::size_t offset = 0;
+    if (head_)
+      offset = AlignUp(head_->used, alignment);
+    if (!head_ || offset + bytes > head_->capacity)
+    {
+      NewBlock(bytes + alignment);
+      offset = AlignUp(head_->used, alignment);
+    }
+    head_->used = offset + bytes;
+    return head_->Data() + offset;
+  }
+
+  /// Free everything allocated from this arena
+  void Release()
+  {
+    while (head_)
+    {
+      Block* previous = head_->previous;
+      std::free(head_);
+      head_ = previous;
+    }
+  }
+
+private:
+  /// Header at the start of every block; the data follows it
+  struct Block {
+    Block* previous;
+    std::size_t capacity;
+    std::size_t used;
+    /// Keeps the data (which starts at sizeof(Block)) maximally aligned
+    union {
+      long double ld;
+      double d;
+      long l;
+      void* p;
+    } align;
+
+    char* Data()
+    {
+      return reinterpret_cast<char*>(this) + sizeof(Block);
+    }
+  };
+
+  /// Round "offset" up so that Data()+offset is a multiple of
+  /// "alignment" (a power of two no larger than malloc's alignment)
+  static std::size_t AlignUp(std::size_t offset, std::size_t alignment)
+  {
+    return (offset + alignment - 1) & ~(alignment - 1);
+  }
+
+  void NewBlock(std::size_t min_capacity)
+  {
+    std::size_t capacity = next_capacity_;
+    if (capacity < min_capacity)
+      capacity = min_capacity;
+    Block* block = static_cast<Block*>(std::malloc(sizeof(Block) + capacity));
+    if (!block)
+      throw std::bad_alloc();
+    block->previous = head_;
+    block->capacity = capacity;
+    block->used = 0;
+    head_ = block;
+    next_capacity_ = 2 * capacity;
+  }
+
+  /// Not copyable
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  /// Newest block; older blocks are chained through Block::previous
+  Block* head_;
+  std::size_t next_capacity_;
+};
+
+
+#endif  // ARENA_H
+
@@ -27,6 +27,7 @@
 #include <cstdlib>   // EXIT_SUCCESS
 #include <iostream>
 #include <limits>    // std::numeric_limits
+#include <new>       // placement new
 #include <vector>
 #if __cplusplus > 199711L
   #include <random>  // std::random_device, std::mt19937, ...
@@ -34,6 +35,8 @@
   #include <ctime>
 #endif
 
+#include "Arena.h"
+
 
 /**
  * Generate a uniformly random number in [-1, +1]
@@ -88,11 +91,12 @@ std::ostream& operator<<(std::ostream& os, const Pos2d& point)
 
 /**
  * Generate a Pos2d with x and y coordinates uniformly i.i.d.
- * in [-1, +1]
+ * in [-1, +1], placed in "arena" right after the previous point
  */
-Pos2d* RandomPos2d()
+Pos2d* RandomPos2d(Arena& arena)
 {
-  Pos2d* new_point = new Pos2d(RandomNumber(), RandomNumber());
+  Pos2d* new_point = new (arena.Allocate<Pos2d>())
+                         Pos2d(RandomNumber(), RandomNumber());
   std::cout << "New point " << *new_point << " created\n";
   return new_point;
 }
@@ -130,9 +134,14 @@ Pos2d* NearestToOrigin(const std::vector<Pos2d*>& points,
 
 int main()
 {
+  const int point_count = 100;
+
+  /// One block for all points: they end up contiguous in memory
+  Arena arena(point_count * sizeof(Pos2d));
   std::vector<Pos2d*> points;
-  for (int i = 0; i < 100; ++i)
-    points.push_back(RandomPos2d());
+  points.reserve(point_count);
+  for (int i = 0; i < point_count; ++i)
+    points.push_back(RandomPos2d(arena));
 
   int nearOrigin = 0;
   for (unsigned int i = 0; i < points.size(); ++i)
@@ -147,9 +156,9 @@ int main()
   std::cout << "The nearest point was " << *nearest_point
             << " with distance " << min_distance << "\n";
 
-  /// Tidy up
-  for (unsigned int i = 0; i < points.size(); ++i)
-    delete points[i];
+  /// Tidy up (Pos2d needs no destructor call, so this frees them all)
+  points.clear();
+  arena.Release();
 
 
 
@@ -0,0 +1,94 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ALIGNEDALLOCATOR_H
+#define ALIGNEDALLOCATOR_H
+
+#include <cstddef>   // std::size_t
+#include <cstdlib>   // posix_memalign, std::free
+#include <limits>    // std::numeric_limits
+#include <new>       // std::bad_alloc
+
+
+/**
+ * A std::allocator replacement which returns memory aligned to
+ * "Alignment" bytes (a power of two, at least sizeof(void*)).
+ *
+ * C++11's operator new does not know about over-aligned types, so
+ * we go through posix_memalign instead. Use it to get e.g. a
+ * cache-line aligned std::vector:
+ *
+ *   std::vector<float, AlignedAllocator<float, 64>> v;
+ */
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+  static_assert((Alignment & (Alignment-1)) == 0,
+                "'AlignedAllocator' alignment must be a power of two!");
+  static_assert(Alignment >= sizeof(void*),
+                "'AlignedAllocator' alignment must be at least sizeof(void*)!");
+
+  typedef T value_type;
+
+  /// Needed because of the non-type template parameter
+  template <typename U>
+  struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(std::size_t n)
+  {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+      throw std::bad_alloc();
+    void* memory = nullptr;
+    if (posix_memalign(&memory, Alignment, n*sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(memory);
+  }
+
+  void deallocate(T* p, std::size_t)
+  {
+    std::free(p);
+  }
+};
+
+/// All instances are interchangeable (stateless allocator)
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&,
+                const AlignedAllocator<U, Alignment>&)
+{
+  return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&,
+                const AlignedAllocator<U, Alignment>&)
+{
+  return false;
+}
+
+
+#endif  // ALIGNEDALLOCATOR_H
+
@@ -0,0 +1,438 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DISTANCEKERNELS_H
+#define DISTANCEKERNELS_H
+
+#include <cmath>     // std::abs
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::int16_t, std::int32_t
+#include <limits>    // std::numeric_limits
+#include <tuple>
+#include <type_traits>
+
+#include "HalfFloat.h"
+#include "Metrics.h"
+#include "Simd.h"
+
+
+/**
+ * The coordinate arrays of the kernels below may be float, Float16 or
+ * BFloat16 ("T"); 16-bit coordinates are widened to float on load, so
+ * all distances are computed and returned as float.
+ */
+template <typename T>
+struct IsKernelCoordinate
+  : std::is_same<typename ComputeType<T>::type, float> { };
+
+
+/**
+ * Batch distances to the origin under "Metric" (see Metrics.h): for i
+ * in [0, count), write Metric::Scalar(x[i], y[i]) to distances[i].
+ *
+ * The bulk of the range goes through simd::kWidth lanes at a time,
+ * the last (count % simd::kWidth) points through the scalar code.
+ * Both produce bit-identical results. "distances" may alias neither
+ * "x" nor "y".
+ */
+template <typename Metric = L1Metric, typename T>
+void DistanceToOrigin(const T* x, const T* y,
+                      std::size_t count, float* distances)
+{
+  static_assert(IsKernelCoordinate<T>::value,
+                "'DistanceToOrigin' kernel needs float or 16-bit floats!");
+  std::size_t i = 0;
+  for (; i + simd::kWidth <= count; i += simd::kWidth)
+    simd::Store(distances + i,
+                Metric::Vector(simd::Load(x + i), simd::Load(y + i)));
+  for (; i < count; ++i)
+    distances[i] = Metric::Scalar(float(x[i]), float(y[i]));
+}
+
+
+/**
+ * Batch distances to the point (qx, qy) under "Metric": for i in
+ * [0, count), write Metric::Scalar(x[i] - qx, y[i] - qy) to
+ * distances[i]. Same rules as the batch DistanceToOrigin above.
+ */
+template <typename Metric = L1Metric, typename T>
+void DistanceToPoint(const T* x, const T* y, std::size_t count,
+                     float qx, float qy, float* distances)
+{
+  static_assert(IsKernelCoordinate<T>::value,
+                "'DistanceToPoint' kernel needs float or 16-bit floats!");
+  const simd::Float lane_qx = simd::Set1(qx);
+  const simd::Float lane_qy = simd::Set1(qy);
+  std::size_t i = 0;
+  for (; i + simd::kWidth <= count; i += simd::kWidth)
+    simd::Store(distances + i,
+                Metric::Vector(simd::Sub(simd::Load(x + i), lane_qx),
+                               simd::Sub(simd::Load(y + i), lane_qy)));
+  for (; i < count; ++i)
+    distances[i] = Metric::Scalar(float(x[i]) - qx, float(y[i]) - qy);
+}
+
+
+/**
+ * Batch version of ManhattanToOrigin: for i in [0, count), write
+ * |x[i]| + |y[i]| to distances[i] (DistanceToOrigin with L1Metric)
+ */
+template <typename T>
+void ManhattanToOrigin(const T* x, const T* y,
+                       std::size_t count, float* distances)
+{
+  DistanceToOrigin<L1Metric>(x, y, count, distances);
+}
+
+
+/**
+ * Batch L1 distances to the point (qx, qy): for i in [0, count), write
+ * |x[i] - qx| + |y[i] - qy| to distances[i] (DistanceToPoint with
+ * L1Metric)
+ */
+template <typename T>
+void ManhattanToPoint(const T* x, const T* y, std::size_t count,
+                      float qx, float qy, float* distances)
+{
+  DistanceToPoint<L1Metric>(x, y, count, qx, qy, distances);
+}
+
+
+/**
+ * Number of i in [0, count) whose distance to the origin under
+ * "Metric" is less than threshold
+ */
+template <typename Metric = L1Metric, typename T>
+std::size_t CountNearOrigin(const T* x, const T* y,
+                            std::size_t count, float threshold)
+{
+  static_assert(IsKernelCoordinate<T>::value,
+                "'CountNearOrigin' kernel needs float or 16-bit floats!");
+  const simd::Float limit = simd::Set1(threshold);
+  std::size_t near = 0;
+  std::size_t i = 0;
+  for (; i + simd::kWidth <= count; i += simd::kWidth)
+  {
+    const simd::Float distance = Metric::Vector(simd::Load(x + i),
+                                                simd::Load(y + i));
+    near += simd::CountTrue(simd::Less(distance, limit));
+  }
+  for (; i < count; ++i)
+    near += (Metric::Scalar(float(x[i]), float(y[i])) < threshold);
+
+  return near;
+}
+
+
+/**
+ * Number of i in [0, count) whose distance to (qx, qy) under "Metric"
+ * is less than threshold
+ */
+template <typename Metric = L1Metric, typename T>
+std::size_t CountNearPoint(const T* x, const T* y, std::size_t count,
+                           float qx, float qy, float threshold)
+{
+  static_assert(IsKernelCoordinate<T>::value,
+                "'CountNearPoint' kernel needs float or 16-bit floats!");
+  const simd::Float lane_qx = simd::Set1(qx);
+  const simd::Float lane_qy = simd::Set1(qy);
+  const simd::Float limit = simd::Set1(threshold);
+  std::size_t near = 0;
+  std::size_t i = 0;
+  for (; i + simd::kWidth <= count; i += simd::kWidth)
+  {
+    const simd::Float distance =
+      Metric::Vector(simd::Sub(simd::Load(x + i), lane_qx),
+                     simd::Sub(simd::Load(y + i), lane_qy));
+    near += simd::CountTrue(simd::Less(distance, limit));
+  }
+  for (; i < count; ++i)
+    near += (Metric::Scalar(float(x[i]) - qx, float(y[i]) - qy)
+             < threshold);
+
+  return near;
+}
+
+
+/**
+ * Integer kernels for int16 fixed-point coordinates (see
+ * QuantizedPointCloud2d.h): the L1 distance |x| + |y| of two int16
+ * values is computed exactly in int32 lanes, and is at most 65536.
+ *
+ * A point with unknown (NaN) coordinates is stored as
+ * (kQuantizedMissing, kQuantizedMissing). Its distance is
+ * kQuantizedMissingDistance, more than that of any other point (at
+ * most 2 * 32767), so it is never near, and never nearest.
+ */
+constexpr std::int16_t kQuantizedMissing =
+  std::numeric_limits<std::int16_t>::min();
+constexpr std::int32_t kQuantizedMissingDistance = 65536;
+
+inline void ManhattanToOrigin(const std::int16_t* x, const std::int16_t* y,
+                              std::size_t count, std::int32_t* distances)
+{
+  std::size_t i = 0;
+  for (; i + simd::kWidth <= count; i += simd::kWidth)
+  {
+    const simd::Int ax = simd::Abs(simd::Load(x + i));
+    const simd::Int ay = simd::Abs(simd::Load(y + i));
+    simd::Store(distances + i, simd::Add(ax, ay));
+  }
+  for (; i < count; ++i)
+    distances[i] = std::abs(std::int32_t(x[i])) + std::abs(std::int32_t(y[i]));
+}
+
+
+/**
+ * Number of i in [0, count) with |x[i]| + |y[i]| < limit (integers),
+ * not counting missing points
+ */
+inline std::size_t CountNearOrigin(const std::int16_t* x,
+                                   const std::int16_t* y,
+                                   std::size_t count, std::int32_t limit)
+{
+  if (limit > kQuantizedMissingDistance)
+    limit = kQuantizedMissingDistance;
+  const simd::Int bound = simd::Set1Int(limit);
+  std::size_t near = 0;
+  std::size_t i = 0;
+  for (; i + simd::kWidth <= count; i += simd::kWidth)
+  {
+    const simd::Int distance = simd::Add(simd::Abs(simd::Load(x + i)),
+                                         simd::Abs(simd::Load(y + i)));
+    near += simd::CountTrue(simd::Less(distance, bound));
+  }
+  for (; i < count; ++i)
+    near += (std::abs(std::int32_t(x[i])) + std::abs(std::int32_t(y[i]))
+             < limit);
+
+  return near;
+}
+
+
+namespace detail {
+
+  /// Loads |x| + |y| of int16 coordinates for ArgExtremum; the sums
+  /// are at most 65536, so their conversion to float is exact. Missing
+  /// points load as std::numeric_limits<float>::max(), which never
+  /// qualifies as nearest.
+  struct QuantizedManhattanLoader {
+    const std::int16_t* x;
+    const std::int16_t* y;
+    simd::Float Vector(std::size_t i) const
+    {
+      const simd::Int distance = simd::Add(simd::Abs(simd::Load(x + i)),
+                                           simd::Abs(simd::Load(y + i)));
+      return simd::Select(
+               simd::Less(distance, simd::Set1Int(kQuantizedMissingDistance)),
+               simd::ToFloat(distance),
+               simd::Set1(std::numeric_limits<float>::max()));
+    }
+    float Scalar(std::size_t i) const
+    {
+      const std::int32_t distance = std::abs(std::int32_t(x[i])) +
+                                    std::abs(std::int32_t(y[i]));
+      return (distance < kQuantizedMissingDistance)
+             ? float(distance) : std::numeric_limits<float>::max();
+    }
+  };
+
+  /// Loads the distances to the origin under "Metric" for ArgExtremum
+  template <typename Metric, typename T>
+  struct DistanceLoader {
+    const T* x;
+    const T* y;
+    simd::Float Vector(std::size_t i) const
+    {
+      return Metric::Vector(simd::Load(x + i), simd::Load(y + i));
+    }
+    float Scalar(std::size_t i) const
+    {
+      return Metric::Scalar(float(x[i]), float(y[i]));
+    }
+  };
+
+  /// Loads precomputed values for ArgExtremum
+  struct ValueLoader {
+    const float* values;
+    simd::Float Vector(std::size_t i) const { return simd::Load(values + i); }
+    float Scalar(std::size_t i) const { return values[i]; }
+  };
+
+  /// "Better" policies for ArgExtremum
+  struct Smaller {
+    static float Initial() { return std::numeric_limits<float>::max(); }
+    static simd::Mask Vector(simd::Float a, simd::Float b) { return simd::Less(a, b); }
+    static bool Scalar(float a, float b) { return a < b; }
+  };
+  struct Larger {
+    static float Initial() { return -std::numeric_limits<float>::infinity(); }
+    static simd::Mask Vector(simd::Float a, simd::Float b) { return simd::Less(b, a); }
+    static bool Scalar(float a, float b) { return b < a; }
+  };
+
+  /**
+   * Index and value of the "best" of the values load(0 .. count-1),
+   * where a value must be strictly Better than the current best (and
+   * Better::Initial()) to replace it. Ties go to the lowest index; if
+   * no value qualifies, the index is "count".
+   *
+   * Every lane keeps its own running best and the index where it
+   * was found. A lane only takes a new value if it is strictly better,
+   * so each lane holds its lowest-index best; the horizontal merge at
+   * the end then breaks ties between lanes by index. Lane indices are
+   * 32 bits wide, so very large ranges are processed in blocks.
+   */
+  template <typename Better, typename Loader>
+  std::tuple<std::size_t, float> ArgExtremum(const Loader& load,
+                                             std::size_t count)
+  {
+    constexpr std::size_t kBlockSize = std::size_t(1) << 30;
+
+    std::size_t best_index = count;
+    float best_value = Better::Initial();
+
+    std::size_t i = 0;
+    while (i + simd::kWidth <= count)
+    {
+      const std::size_t block_begin = i;
+      const std::size_t block_end = (count - i > kBlockSize) ? i + kBlockSize
+                                                             : count;
+
+      simd::Float lane_best = simd::Set1(Better::Initial());
+      simd::Int lane_index = simd::Set1Int(-1);
+      simd::Int index = simd::LaneIndices();
+      const simd::Int step = simd::Set1Int(simd::kWidth);
+      for (; i + simd::kWidth <= block_end; i += simd::kWidth)
+      {
+        const simd::Float value = load.Vector(i);
+        const simd::Mask better = Better::Vector(value, lane_best);
+        lane_best = simd::Select(better, value, lane_best);
+        lane_index = simd::Select(better, index, lane_index);
+        index = simd::Add(index, step);
+      }
+
+      /// Horizontal merge; earlier blocks win ties against later ones
+      float lane_bests[simd::kWidth];
+      std::int32_t lane_indices[simd::kWidth];
+      simd::Store(lane_bests, lane_best);
+      simd::Store(lane_indices, lane_index);
+      for (std::size_t lane = 0; lane < simd::kWidth; ++lane)
+      {
+        if (lane_indices[lane] < 0)
+          continue;
+        const std::size_t candidate = block_begin + lane_indices[lane];
+        if (Better::Scalar(lane_bests[lane], best_value) ||
+            (lane_bests[lane] == best_value && candidate < best_index))
+        {
+          best_index = candidate;
+          best_value = lane_bests[lane];
+        }
+      }
+    }
+
+    for (; i < count; ++i)
+    {
+      const float value = load.Scalar(i);
+      if (Better::Scalar(value, best_value))
+      {
+        best_index = i;
+        best_value = value;
+      }
+    }
+
+    return std::make_tuple(best_index, best_value);
+  }
+
+}  // namespace detail
+
+
+/**
+ * Find i in [0, count) with the smallest distance to the origin under
+ * "Metric" (by default |x[i]| + |y[i]|).
+ *
+ * Returns that index and its distance. Ties go to the lowest index,
+ * and (like the scalar loop) a point only counts if its distance is
+ * less than std::numeric_limits<float>::max(); if there is no such
+ * point, the index is "count".
+ */
+template <typename Metric = L1Metric, typename T>
+std::tuple<std::size_t, float> NearestToOrigin(const T* x, const T* y,
+                                               std::size_t count)
+{
+  static_assert(IsKernelCoordinate<T>::value,
+                "'NearestToOrigin' kernel needs float or 16-bit floats!");
+  return detail::ArgExtremum<detail::Smaller>(
+           detail::DistanceLoader<Metric, T>{x, y}, count);
+}
+
+
+/**
+ * NearestToOrigin for int16 coordinates: the index and the (exact,
+ * integer) L1 distance of the nearest point, lowest index on ties. For
+ * count == 0 the index is 0 and the distance is
+ * std::numeric_limits<std::int32_t>::max().
+ */
+inline std::tuple<std::size_t, std::int32_t> NearestToOrigin(
+                          const std::int16_t* x, const std::int16_t* y,
+                          std::size_t count
+                                                            )
+{
+  const std::tuple<std::size_t, float> nearest =
+    detail::ArgExtremum<detail::Smaller>(
+      detail::QuantizedManhattanLoader{x, y}, count);
+  if (std::get<0>(nearest) == count)
+    return std::make_tuple(count, std::numeric_limits<std::int32_t>::max());
+  return std::make_tuple(std::get<0>(nearest),
+                         static_cast<std::int32_t>(std::get<1>(nearest)));
+}
+
+
+/**
+ * Index and value of the smallest of values[0 .. count-1], with the
+ * same rules as NearestToOrigin
+ */
+inline std::tuple<std::size_t, float> ArgMin(const float* values,
+                                             std::size_t count)
+{
+  return detail::ArgExtremum<detail::Smaller>(detail::ValueLoader{values},
+                                              count);
+}
+
+
+/**
+ * Index and value of the largest of values[0 .. count-1]; ties go to
+ * the lowest index, NaNs are ignored. If there is no such value, the
+ * index is "count" and the value is -infinity.
+ */
+inline std::tuple<std::size_t, float> ArgMax(const float* values,
+                                             std::size_t count)
+{
+  return detail::ArgExtremum<detail::Larger>(detail::ValueLoader{values},
+                                             count);
+}
+
+
+#endif  // DISTANCEKERNELS_H
+
@@ -0,0 +1,373 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FLOATFORMAT_H
+#define FLOATFORMAT_H
+
+#include <cstdint>   // std::int32_t, std::uint32_t, std::uint64_t
+#include <cstring>   // std::memcpy
+
+
+/**
+ * Shortest round-trip formatting of floats
+ *
+ * FormatFloat() writes the shortest decimal string which reads back
+ * (with strtof, std::stof, operator>> ...) as exactly the same float:
+ * 0.1f becomes "0.1", not "0.100000001". The digits are computed with
+ * Ulf Adams' Ryu algorithm ("Ryu: Fast Float-to-String Conversion",
+ * PLDI 2018), which needs only integer arithmetic and two small
+ * tables of powers of five; there is no locale, no printf format
+ * parsing and no iostream machinery involved.
+ *
+ * Numbers are written in plain notation when that is short ("0.25",
+ * "-12.5", "0.00123") and in scientific notation otherwise ("1e+20",
+ * "1.5e-10"). Infinities are written as "inf" / "-inf", NaNs as "nan"
+ * (which reads back as a NaN, though not necessarily with the same
+ * payload bits).
+ */
+
+
+/// Longest output of FormatFloat(), e.g. "-1.17549435e-38"
+constexpr int kMaxFloatChars = 16;
+
+
+namespace detail {
+
+  constexpr int kRyuFloatPow5InvBitCount = 59;
+  constexpr int kRyuFloatPow5BitCount = 61;
+
+  /// floor(2^(bits(5^i) - 1 + 59) / 5^i) + 1
+  constexpr std::uint64_t kRyuFloatPow5InvSplit[31] = {
+    0x0800000000000001ull, 0x0666666666666667ull, 0x051eb851eb851eb9ull,
+    0x04189374bc6a7efaull, 0x068db8bac710cb2aull, 0x053e2d6238da3c22ull,
+    0x0431bde82d7b634eull, 0x06b5fca6af2bd216ull, 0x055e63b88c230e78ull,
+    0x044b82fa09b5a52dull, 0x06df37f675ef6eaeull, 0x057f5ff85e592558ull,
+    0x0465e6604b7a8447ull, 0x0709709a125da071ull, 0x05a126e1a84ae6c1ull,
+    0x0480ebe7b9d58567ull, 0x0734aca5f6226f0bull, 0x05c3bd5191b525a3ull,
+    0x049c97747490eae9ull, 0x0760f253edb4ab0eull, 0x05e72843249088d8ull,
+    0x04b8ed0283a6d3e0ull, 0x078e480405d7b966ull, 0x060b6cd004ac9452ull,
+    0x04d5f0a66a23a9dbull, 0x07bcb43d769f762bull, 0x063090312bb2c4efull,
+    0x04f3a68dbc8f03f3ull, 0x07ec3daf94180651ull, 0x065697bfa9acd1daull,
+    0x051212ffbaf0a7e2ull,
+  };
+
+  /// 5^i, normalized to 61 bits
+  constexpr std::uint64_t kRyuFloatPow5Split[47] = {
+    0x1000000000000000ull, 0x1400000000000000ull, 0x1900000000000000ull,
+    0x1f40000000000000ull, 0x1388000000000000ull, 0x186a000000000000ull,
+    0x1e84800000000000ull, 0x1312d00000000000ull, 0x17d7840000000000ull,
+    0x1dcd650000000000ull, 0x12a05f2000000000ull, 0x174876e800000000ull,
+    0x1d1a94a200000000ull, 0x12309ce540000000ull, 0x16bcc41e90000000ull,
+    0x1c6bf52634000000ull, 0x11c37937e0800000ull, 0x16345785d8a00000ull,
+    0x1bc16d674ec80000ull, 0x1158e460913d0000ull, 0x15af1d78b58c4000ull,
+    0x1b1ae4d6e2ef5000ull, 0x10f0cf064dd59200ull, 0x152d02c7e14af680ull,
+    0x1a784379d99db420ull, 0x108b2a2c28029094ull, 0x14adf4b7320334b9ull,
+    0x19d971e4fe8401e7ull, 0x1027e72f1f128130ull, 0x1431e0fae6d7217cull,
+    0x193e5939a08ce9dbull, 0x1f8def8808b02452ull, 0x13b8b5b5056e16b3ull,
+    0x18a6e32246c99c60ull, 0x1ed09bead87c0378ull, 0x13426172c74d822bull,
+    0x1812f9cf7920e2b6ull, 0x1e17b84357691b64ull, 0x12ced32a16a1b11eull,
+    0x178287f49c4a1d66ull, 0x1d6329f1c35ca4bfull, 0x125dfa371a19e6f7ull,
+    0x16f578c4e0a060b5ull, 0x1cb2d6f618c878e3ull, 0x11efc659cf7d4b8dull,
+    0x166bb7f0435c9e71ull, 0x1c06a5ec5433c60dull,
+  };
+
+  /// Number of bits of 5^e (1 for e == 0)
+  inline std::int32_t RyuPow5Bits(std::int32_t e)
+  {
+    return static_cast<std::int32_t>(((std::uint32_t(e) * 1217359) >> 19) + 1);
+  }
+
+  /// floor(log10(2^e)) and floor(log10(5^e)), for 0 <= e <= 1650
+  inline std::uint32_t RyuLog10Pow2(std::int32_t e)
+  {
+    return (std::uint32_t(e) * 78913) >> 18;
+  }
+  inline std::uint32_t RyuLog10Pow5(std::int32_t e)
+  {
+    return (std::uint32_t(e) * 732923) >> 20;
+  }
+
+  inline bool RyuMultipleOfPowerOf5(std::uint32_t value, std::uint32_t p)
+  {
+    std::uint32_t count = 0;
+    while (value % 5 == 0 && value != 0)
+    {
+      value /= 5;
+      ++count;
+    }
+    return count >= p;
+  }
+
+  inline bool RyuMultipleOfPowerOf2(std::uint32_t value, std::uint32_t p)
+  {
+    return (value & ((1u << p) - 1)) == 0;
+  }
+
+  /// (m * factor) >> shift, for 32 < shift
+  inline std::uint32_t RyuMulShift(std::uint32_t m, std::uint64_t factor,
+                                   std::int32_t shift)
+  {
+    const std::uint64_t low = std::uint64_t(m) * std::uint32_t(factor);
+    const std::uint64_t high = std::uint64_t(m) * std::uint32_t(factor >> 32);
+    return static_cast<std::uint32_t>(((low >> 32) + high) >> (shift - 32));
+  }
+
+  /**
+   * The shortest decimal digits and exponent of a positive finite
+   * float: value == digits * 10^exponent, after reading back
+   */
+  inline void RyuShortest(std::uint32_t mantissa_bits,
+                          std::uint32_t exponent_bits,
+                          std::uint32_t& digits, std::int32_t& exponent)
+  {
+    std::int32_t e2;
+    std::uint32_t m2;
+    if (exponent_bits == 0)
+    {
+      e2 = 1 - 127 - 23 - 2;
+      m2 = mantissa_bits;
+    }
+    else
+    {
+      e2 = std::int32_t(exponent_bits) - 127 - 23 - 2;
+      m2 = (1u << 23) | mantissa_bits;
+    }
+    const bool accept_bounds = (m2 & 1) == 0;
+
+    /// The interval of decimals which round to this float: (mm, mp)
+    /// around mv, all scaled by 4 to stay integral
+    const std::uint32_t mv = 4 * m2;
+    const std::uint32_t mp = 4 * m2 + 2;
+    const std::uint32_t mm_shift = (mantissa_bits != 0 || exponent_bits <= 1);
+    const std::uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+    /// Convert the interval to a decimal power
+    std::uint32_t vr, vp, vm;
+    std::int32_t e10;
+    bool vm_is_trailing_zeros = false;
+    bool vr_is_trailing_zeros = false;
+    std::uint32_t last_removed_digit = 0;
+    if (e2 >= 0)
+    {
+      const std::uint32_t q = RyuLog10Pow2(e2);
+      e10 = std::int32_t(q);
+      const std::int32_t k = kRyuFloatPow5InvBitCount
+                             + RyuPow5Bits(std::int32_t(q)) - 1;
+      const std::int32_t i = -e2 + std::int32_t(q) + k;
+      vr = RyuMulShift(mv, kRyuFloatPow5InvSplit[q], i);
+      vp = RyuMulShift(mp, kRyuFloatPow5InvSplit[q], i);
+      vm = RyuMulShift(mm, kRyuFloatPow5InvSplit[q], i);
+      if (q != 0 && (vp - 1) / 10 <= vm / 10)
+      {
+        /// One removed digit is needed even without the loop below
+        const std::int32_t l = kRyuFloatPow5InvBitCount
+                               + RyuPow5Bits(std::int32_t(q - 1)) - 1;
+        last_removed_digit = RyuMulShift(mv, kRyuFloatPow5InvSplit[q - 1],
+                                         -e2 + std::int32_t(q) - 1 + l) % 10;
+      }
+      if (q <= 9)
+      {
+        /// Only one of mp, mv and mm can be a multiple of 5, if any
+        if (mv % 5 == 0)
+          vr_is_trailing_zeros = RyuMultipleOfPowerOf5(mv, q);
+        else if (accept_bounds)
+          vm_is_trailing_zeros = RyuMultipleOfPowerOf5(mm, q);
+        else
+          vp -= RyuMultipleOfPowerOf5(mp, q);
+      }
+    }
+    else
+    {
+      const std::uint32_t q = RyuLog10Pow5(-e2);
+      e10 = std::int32_t(q) + e2;
+      const std::int32_t i = -e2 - std::int32_t(q);
+      const std::int32_t k = RyuPow5Bits(i) - kRyuFloatPow5BitCount;
+      std::int32_t j = std::int32_t(q) - k;
+      vr = RyuMulShift(mv, kRyuFloatPow5Split[i], j);
+      vp = RyuMulShift(mp, kRyuFloatPow5Split[i], j);
+      vm = RyuMulShift(mm, kRyuFloatPow5Split[i], j);
+      if (q != 0 && (vp - 1) / 10 <= vm / 10)
+      {
+        j = std::int32_t(q) - 1 - (RyuPow5Bits(i + 1) - kRyuFloatPow5BitCount);
+        last_removed_digit = RyuMulShift(mv, kRyuFloatPow5Split[i + 1], j) % 10;
+      }
+      if (q <= 1)
+      {
+        /// mv = 4 * m2 has at least two trailing zero bits
+        vr_is_trailing_zeros = true;
+        if (accept_bounds)
+          vm_is_trailing_zeros = (mm_shift == 1);
+        else
+          --vp;
+      }
+      else if (q < 31)
+      {
+        vr_is_trailing_zeros = RyuMultipleOfPowerOf2(mv, q - 1);
+      }
+    }
+
+    /// Remove digits while the interval still contains a shorter number
+    std::int32_t removed = 0;
+    if (vm_is_trailing_zeros || vr_is_trailing_zeros)
+    {
+      while (vp / 10 > vm / 10)
+      {
+        vm_is_trailing_zeros &= (vm % 10 == 0);
+        vr_is_trailing_zeros &= (last_removed_digit == 0);
+        last_removed_digit = vr % 10;
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        ++removed;
+      }
+      if (vm_is_trailing_zeros)
+      {
+        while (vm % 10 == 0)
+        {
+          vr_is_trailing_zeros &= (last_removed_digit == 0);
+          last_removed_digit = vr % 10;
+          vr /= 10;
+          vp /= 10;
+          vm /= 10;
+          ++removed;
+        }
+      }
+      /// Exactly halfway: round to even
+      if (vr_is_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0)
+        last_removed_digit = 4;
+      digits = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros))
+                     || last_removed_digit >= 5);
+    }
+    else
+    {
+      while (vp / 10 > vm / 10)
+      {
+        last_removed_digit = vr % 10;
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        ++removed;
+      }
+      digits = vr + (vr == vm || last_removed_digit >= 5);
+    }
+    exponent = e10 + removed;
+  }
+
+}  // namespace detail
+
+
+/**
+ * Write the shortest round-trip representation of "value" to "out"
+ * (at most kMaxFloatChars characters, no terminating '\0'); returns
+ * the end of the written characters
+ */
+inline char* FormatFloat(float value, char* out)
+{
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const std::uint32_t mantissa_bits = bits & 0x7fffff;
+  const std::uint32_t exponent_bits = (bits >> 23) & 0xff;
+
+  if (exponent_bits == 0xff && mantissa_bits != 0)
+  {
+    std::memcpy(out, "nan", 3);
+    return out + 3;
+  }
+  if (bits >> 31)
+    *out++ = '-';
+  if (exponent_bits == 0xff)
+  {
+    std::memcpy(out, "inf", 3);
+    return out + 3;
+  }
+  if (exponent_bits == 0 && mantissa_bits == 0)
+  {
+    *out++ = '0';
+    return out;
+  }
+
+  std::uint32_t digits;
+  std::int32_t exponent;
+  detail::RyuShortest(mantissa_bits, exponent_bits, digits, exponent);
+
+  char text[10];
+  std::int32_t length = 0;
+  for (std::uint32_t rest = digits; rest != 0; rest /= 10)
+    text[9 - length++] = static_cast<char>('0' + rest % 10);
+  const char* first = text + 10 - length;
+
+  /// Digits before the decimal point: value = 0.<digits> * 10^point
+  const std::int32_t point = length + exponent;
+  if (0 < point && point <= 9 && exponent >= 0)
+  {
+    /// Integer: "123", "1200"
+    std::memcpy(out, first, length);
+    out += length;
+    for (std::int32_t zero = 0; zero < exponent; ++zero)
+      *out++ = '0';
+  }
+  else if (0 < point && point <= 9)
+  {
+    /// "12.5"
+    std::memcpy(out, first, point);
+    out += point;
+    *out++ = '.';
+    std::memcpy(out, first + point, length - point);
+    out += length - point;
+  }
+  else if (-5 < point && point <= 0)
+  {
+    /// "0.00125"
+    *out++ = '0';
+    *out++ = '.';
+    for (std::int32_t zero = 0; zero < -point; ++zero)
+      *out++ = '0';
+    std::memcpy(out, first, length);
+    out += length;
+  }
+  else
+  {
+    /// "1.25e-10"
+    *out++ = first[0];
+    if (length > 1)
+    {
+      *out++ = '.';
+      std::memcpy(out, first + 1, length - 1);
+      out += length - 1;
+    }
+    std::int32_t scientific = point - 1;
+    *out++ = 'e';
+    *out++ = (scientific < 0) ? '-' : '+';
+    if (scientific < 0)
+      scientific = -scientific;
+    if (scientific >= 10)
+      *out++ = static_cast<char>('0' + scientific / 10);
+    *out++ = static_cast<char>('0' + scientific % 10);
+  }
+  return out;
+}
+
+
+#endif  // FLOATFORMAT_H
+
@@ -0,0 +1,430 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GRIDINDEX_H
+#define GRIDINDEX_H
+
+#include <algorithm> // std::min, std::max, std::sort
+#include <cmath>     // std::floor, std::sqrt, std::isfinite
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::int64_t, std::uint64_t
+#include <limits>    // std::numeric_limits
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "DistanceKernels.h"
+#include "PointCloud2d.h"
+
+
+/**
+ * A uniform grid over a point set, for L1 radius queries at any query
+ * point
+ *
+ * The bounding box of the points is cut into square cells; the points
+ * are stored grouped by cell (each cell's points are one contiguous
+ * run, in index order, and the runs are in row-major cell order), and
+ * an open-addressing hash table with linear probing maps a cell
+ * (cx, cy) to its run. Only non-empty cells are in the table, so a
+ * sparse or clustered set does not pay for the empty parts of its
+ * bounding box.
+ *
+ * A query for the points within L1 radius r of q only looks at the
+ * cells that overlap the "diamond" |x - qx| + |y - qy| < r. Cells
+ * that lie completely inside it are counted (or listed) as a whole,
+ * cells on its border are scanned with the SIMD kernels. Unless the
+ * cell size is chosen by hand, it is such that an average cell holds
+ * about kPointsPerCell points, so for small radii a query costs about
+ * (number of results + perimeter cells), not N. Radii so large that
+ * the cell lookups would cost more than a scan of all points fall back
+ * to that scan.
+ *
+ * Points with a non-finite coordinate are left out of the grid.
+ */
+class GridIndex2d {
+public:
+  /// Average number of points per cell, for the default cell size
+  static constexpr double kPointsPerCell = 8.;
+  /// The grid is at most this many cells wide and high
+  static constexpr std::int64_t kMaxCellsPerAxis = std::int64_t(1) << 20;
+
+  typedef std::vector<float, AlignedAllocator<float, kPointCloudAlignment>>
+          Column;
+
+  GridIndex2d()
+  : origin_x_{0.}, origin_y_{0.}, cell_size_{1.}, cells_x_{1}, cells_y_{1},
+    cells_{0}, slots_(kMinSlots), shift_{64 - kMinSlotBits}
+  { }
+
+  /**
+   * Build over "points" (anything with size(), x_data() and y_data()).
+   * A "cell_size" of 0 picks one from the density of the points.
+   */
+  template <typename Points>
+  explicit GridIndex2d(const Points& points, double cell_size = 0.)
+  : GridIndex2d()
+  {
+    Build(points, cell_size);
+  }
+
+  /// Number of points in the grid
+  std::size_t size() const { return x_.size(); }
+  bool empty() const { return x_.empty(); }
+
+  double cell_size() const { return cell_size_; }
+
+  /// Number of non-empty cells
+  std::size_t cell_count() const { return cells_; }
+
+  /**
+   * Number of points with an L1 distance to (qx, qy) less than
+   * "radius"; the same as CountNearPoint over all points
+   */
+  std::size_t CountWithin(float qx, float qy, float radius) const
+  {
+    std::size_t count = 0;
+    VisitCells(qx, qy, radius, [&](const Slot& cell, bool inside) {
+      count += inside ? cell.count
+                      : CountNearPoint(x_.data() + cell.begin,
+                                       y_.data() + cell.begin, cell.count,
+                                       qx, qy, radius);
+    });
+    return count;
+  }
+
+  /**
+   * Indices of the points with an L1 distance to (qx, qy) less than
+   * "radius", grouped by cell (sort them if the order matters)
+   */
+  std::vector<std::size_t> Within(float qx, float qy, float radius) const
+  {
+    std::vector<std::size_t> indices;
+    VisitCells(qx, qy, radius, [&](const Slot& cell, bool inside) {
+      const std::size_t* cell_indices = index_.data() + cell.begin;
+      if (inside)
+      {
+        indices.insert(indices.end(), cell_indices,
+                       cell_indices + cell.count);
+        return;
+      }
+      float distances[kScanBlockPoints];
+      for (std::size_t i = 0; i < cell.count; i += kScanBlockPoints)
+      {
+        const std::size_t block = (cell.count - i < kScanBlockPoints)
+                                  ? cell.count - i : kScanBlockPoints;
+        ManhattanToPoint(x_.data() + cell.begin + i,
+                         y_.data() + cell.begin + i, block, qx, qy,
+                         distances);
+        for (std::size_t j = 0; j < block; ++j)
+          if (distances[j] < radius)
+            indices.push_back(cell_indices[i + j]);
+      }
+    });
+    return indices;
+  }
+
+private:
+  static constexpr unsigned kMinSlotBits = 4;
+  static constexpr std::size_t kMinSlots = std::size_t(1) << kMinSlotBits;
+  /// Border cells are scanned in blocks of this many points
+  static constexpr std::size_t kScanBlockPoints = 256;
+  /// Cells are treated as this much (relative to the cell size)
+  /// larger than they are, so that rounding in the cell arithmetic
+  /// never drops a point
+  static constexpr double kCellMargin = 1. / (1 << 20);
+  /// Relative slack for the float rounding of point distances
+  static constexpr double kDistanceSlack = 1. / (1 << 20);
+  /// Cost of looking up a cell, in points scanned
+  static constexpr double kCellCost = 32.;
+  /// Marks points which are not in the grid
+  static constexpr std::uint64_t kNoCell =
+    std::numeric_limits<std::uint64_t>::max();
+
+  /// A hash table entry: the points of cell "key" are the "count"
+  /// points from "begin" on; count == 0 marks a free slot
+  struct Slot {
+    std::uint64_t key;
+    std::size_t begin;
+    std::size_t count;
+  };
+
+  static std::uint64_t Key(std::int64_t cx, std::int64_t cy)
+  {
+    return (std::uint64_t(cy) << 32) | std::uint64_t(cx);
+  }
+
+  /// Home slot of "key" (Fibonacci hashing)
+  std::size_t Home(std::uint64_t key) const
+  {
+    return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> shift_);
+  }
+
+  /// Slot number of "key", or slots_.size() if the cell is empty
+  std::size_t Find(std::uint64_t key) const
+  {
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t slot = Home(key); ; slot = (slot + 1) & mask)
+    {
+      if (slots_[slot].count == 0)
+        return slots_.size();
+      if (slots_[slot].key == key)
+        return slot;
+    }
+  }
+
+  /// The slot of "key", which is added (with count 0) if it is new;
+  /// the table is kept at most half full
+  Slot& FindOrAdd(std::uint64_t key)
+  {
+    if (2 * (cells_ + 1) > slots_.size())
+      Grow();
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t slot = Home(key);
+    for (; slots_[slot].count != 0; slot = (slot + 1) & mask)
+      if (slots_[slot].key == key)
+        return slots_[slot];
+    ++cells_;
+    slots_[slot].key = key;
+    return slots_[slot];
+  }
+
+  void Grow()
+  {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(2 * old.size());
+    --shift_;
+    const std::size_t mask = slots_.size() - 1;
+    for (const Slot& entry: old)
+    {
+      if (entry.count == 0)
+        continue;
+      std::size_t slot = Home(entry.key);
+      while (slots_[slot].count != 0)
+        slot = (slot + 1) & mask;
+      slots_[slot] = entry;
+    }
+  }
+
+  std::int64_t CellX(double x) const
+  {
+    const double cell = std::floor((x - origin_x_) / cell_size_);
+    return std::min(std::max(static_cast<std::int64_t>(cell),
+                             std::int64_t(0)), cells_x_ - 1);
+  }
+
+  std::int64_t CellY(double y) const
+  {
+    const double cell = std::floor((y - origin_y_) / cell_size_);
+    return std::min(std::max(static_cast<std::int64_t>(cell),
+                             std::int64_t(0)), cells_y_ - 1);
+  }
+
+  template <typename Points>
+  void Build(const Points& points, double cell_size)
+  {
+    const std::size_t count = points.size();
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = min_x;
+    double max_x = -min_x;
+    double max_y = -min_x;
+    std::size_t finite = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const float x = points.x_data()[i];
+      const float y = points.y_data()[i];
+      if (!std::isfinite(x) || !std::isfinite(y))
+        continue;
+      min_x = std::min(min_x, double(x));
+      min_y = std::min(min_y, double(y));
+      max_x = std::max(max_x, double(x));
+      max_y = std::max(max_y, double(y));
+      ++finite;
+    }
+    if (finite == 0)
+      return;
+
+    /// Cells of about kPointsPerCell points (for uniform density)
+    const double width = max_x - min_x;
+    const double height = max_y - min_y;
+    const double extent = std::max(width, height);
+    if (!(cell_size > 0.))
+      cell_size = (width > 0. && height > 0.)
+                  ? std::sqrt(width * height * kPointsPerCell / finite)
+                  : extent * kPointsPerCell / finite;
+    cell_size = std::max(cell_size, extent / (kMaxCellsPerAxis - 1));
+    if (!(cell_size > 0.))
+      cell_size = 1.;  // all points are the same
+    origin_x_ = min_x;
+    origin_y_ = min_y;
+    cell_size_ = cell_size;
+    cells_x_ = static_cast<std::int64_t>(width / cell_size) + 1;
+    cells_y_ = static_cast<std::int64_t>(height / cell_size) + 1;
+
+    /// Count the points per cell ...
+    std::vector<std::uint64_t> keys(count, std::uint64_t(kNoCell));
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const float x = points.x_data()[i];
+      const float y = points.y_data()[i];
+      if (!std::isfinite(x) || !std::isfinite(y))
+        continue;
+      keys[i] = Key(CellX(x), CellY(y));
+      ++FindOrAdd(keys[i]).count;
+    }
+
+    /// ... give every cell its run, row by row, so that neighbouring
+    /// cells of a row are neighbours in memory too ...
+    std::vector<std::size_t> row_major;
+    row_major.reserve(cells_);
+    for (std::size_t slot = 0; slot < slots_.size(); ++slot)
+      if (slots_[slot].count != 0)
+        row_major.push_back(slot);
+    std::sort(row_major.begin(), row_major.end(),
+              [this](std::size_t a, std::size_t b) {
+                return slots_[a].key < slots_[b].key;
+              });
+    std::size_t next = 0;
+    for (std::size_t slot: row_major)
+    {
+      slots_[slot].begin = next;
+      next += slots_[slot].count;
+    }
+
+    /// ... and fill the runs in index order; "begin" is moved along
+    /// while a cell is filled and set back afterwards
+    x_.resize(finite);
+    y_.resize(finite);
+    index_.resize(finite);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      if (keys[i] == kNoCell)
+        continue;
+      Slot& slot = slots_[Find(keys[i])];
+      x_[slot.begin] = points.x_data()[i];
+      y_[slot.begin] = points.y_data()[i];
+      index_[slot.begin] = i;
+      ++slot.begin;
+    }
+    for (Slot& slot: slots_)
+      slot.begin -= slot.count;
+  }
+
+  /**
+   * Call visit(cell, inside) for every non-empty cell which may hold
+   * points with an L1 distance to (qx, qy) less than "radius"; "inside"
+   * is true if all of its points have one
+   */
+  template <typename Visit>
+  void VisitCells(float qx, float qy, float radius, const Visit& visit) const
+  {
+    if (cells_ == 0 || !(radius > 0.f) ||
+        !std::isfinite(qx) || !std::isfinite(qy))
+      return;
+
+    const double r = radius;
+    /// Position of q in (fractional) cells
+    const double cell_qx = (qx - origin_x_) / cell_size_;
+    const double cell_qy = (qy - origin_y_) / cell_size_;
+    /// Reach of the (slightly enlarged) radius in cells
+    const double reach = r * (1. + kDistanceSlack) / cell_size_ + kCellMargin;
+
+    const double first_y = std::max(std::floor(cell_qy - reach), 0.);
+    const double last_y = std::min(std::floor(cell_qy + reach),
+                                   double(cells_y_ - 1));
+    const double first_x = std::max(std::floor(cell_qx - reach), 0.);
+    const double last_x = std::min(std::floor(cell_qx + reach),
+                                   double(cells_x_ - 1));
+    if (first_y > last_y || first_x > last_x)
+      return;
+
+    /// For large radii, scanning all points beats looking up the cells
+    if ((last_x - first_x + 1) * (last_y - first_y + 1) * kCellCost >
+        double(size()))
+    {
+      visit(Slot{0, 0, size()}, false);
+      return;
+    }
+
+    for (std::int64_t cy = std::int64_t(first_y);
+         cy <= std::int64_t(last_y); ++cy)
+    {
+      /// The diamond is narrower away from qy
+      const double row_offset = std::max(0., std::max(cy - cell_qy,
+                                                      cell_qy - (cy + 1)));
+      const double row_reach = reach - row_offset;
+      if (row_reach < 0.)
+        continue;
+      const std::int64_t row_first_x = std::int64_t(
+          std::max(std::floor(cell_qx - row_reach), first_x));
+      const std::int64_t row_last_x = std::int64_t(
+          std::min(std::floor(cell_qx + row_reach), last_x));
+      for (std::int64_t cx = row_first_x; cx <= row_last_x; ++cx)
+      {
+        const std::size_t slot = Find(Key(cx, cy));
+        if (slot < slots_.size())
+          VisitCell(slots_[slot], qx, qy, r, visit);
+      }
+    }
+  }
+
+  /// visit(cell, inside) if the cell is not entirely out of reach
+  template <typename Visit>
+  void VisitCell(const Slot& slot, double qx, double qy, double r,
+                 const Visit& visit) const
+  {
+    const double margin = cell_size_ * kCellMargin;
+    const double cx = double(slot.key & 0xffffffffu);
+    const double cy = double(slot.key >> 32);
+    const double lo_x = origin_x_ + cx * cell_size_ - margin;
+    const double hi_x = origin_x_ + (cx + 1) * cell_size_ + margin;
+    const double lo_y = origin_y_ + cy * cell_size_ - margin;
+    const double hi_y = origin_y_ + (cy + 1) * cell_size_ + margin;
+
+    const double near = std::max(0., std::max(lo_x - qx, qx - hi_x)) +
+                        std::max(0., std::max(lo_y - qy, qy - hi_y));
+    if (near * (1. - kDistanceSlack) >= r)
+      return;
+    const double far = std::max(qx - lo_x, hi_x - qx) +
+                       std::max(qy - lo_y, hi_y - qy);
+    visit(slot, far * (1. + kDistanceSlack) < r);
+  }
+
+  double origin_x_;
+  double origin_y_;
+  double cell_size_;
+  std::int64_t cells_x_;
+  std::int64_t cells_y_;
+
+  /// Number of non-empty cells
+  std::size_t cells_;
+  std::vector<Slot> slots_;
+  unsigned shift_;
+
+  Column x_;
+  Column y_;
+  std::vector<std::size_t> index_;
+};
+
+
+#endif  // GRIDINDEX_H
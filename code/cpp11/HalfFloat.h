@@ -0,0 +1,205 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HALFFLOAT_H
+#define HALFFLOAT_H
+
+#include <cstdint>   // std::uint16_t, std::uint32_t
+#include <cstring>   // std::memcpy
+#include <type_traits>
+#if defined(__F16C__)
+  #include <immintrin.h>
+#endif
+
+
+/**
+ * 16-bit floating point storage types
+ *
+ * Float16 is IEEE 754 binary16 (1 sign, 5 exponent, 10 mantissa bits;
+ * about 3 decimal digits, range +-65504). BFloat16 is the upper half
+ * of a float (1 sign, 8 exponent, 7 mantissa bits; float's range,
+ * about 2 decimal digits).
+ *
+ * Both are storage formats only: there is no arithmetic on them.
+ * Values are widened to float (exactly) on load and all computation
+ * happens in float; storing rounds to nearest, ties to even. Point
+ * coordinates in [-1, +1] lose precision (2^-11 resp. 2^-8 relative),
+ * but take half the memory, and scans over them move half the bytes.
+ */
+
+
+namespace detail {
+
+  inline std::uint32_t FloatBits(float value)
+  {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  inline float BitsFloat(std::uint32_t bits)
+  {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+}  // namespace detail
+
+
+struct Float16 {
+  Float16() = default;
+
+  Float16(float value)
+  : bits{FromFloat(value)}
+  { }
+
+  operator float() const { return ToFloat(bits); }
+
+  /// float -> binary16 bits, round to nearest even
+  static std::uint16_t FromFloat(float value)
+  {
+    #if defined(__F16C__)
+      return static_cast<std::uint16_t>(_cvtss_sh(value, 0));
+    #else
+      std::uint32_t x = detail::FloatBits(value);
+      const std::uint16_t sign = static_cast<std::uint16_t>((x >> 16) & 0x8000);
+      x &= 0x7fffffff;
+      std::uint32_t half;
+      if (x >= 0x47800000)
+      {
+        /// >= 65536 (or Inf, NaN); 65520 .. 65535 round up to Inf below
+        half = (x > 0x7f800000) ? 0x7e00 : 0x7c00;
+      }
+      else if (x >= 0x38800000)
+      {
+        /// Normal: rebias the exponent and round away 13 mantissa bits
+        x += ((15u - 127u) << 23) + 0xfff + ((x >> 13) & 1);
+        half = x >> 13;
+      }
+      else if (x > 0x33000000)
+      {
+        /// Subnormal: the significand in units of 2^-24, rounded
+        const std::uint32_t exponent = x >> 23;
+        const std::uint32_t significand = (x & 0x7fffff) | 0x800000;
+        const std::uint32_t shift = 126 - exponent;
+        const std::uint32_t rest = significand & ((1u << shift) - 1);
+        const std::uint32_t halfway = 1u << (shift - 1);
+        half = significand >> shift;
+        if (rest > halfway || (rest == halfway && (half & 1)))
+          ++half;
+      }
+      else
+      {
+        /// At most 2^-25: rounds to zero
+        half = 0;
+      }
+      return static_cast<std::uint16_t>(sign | half);
+    #endif
+  }
+
+  /// binary16 bits -> float (exact)
+  static float ToFloat(std::uint16_t half)
+  {
+    #if defined(__F16C__)
+      return _cvtsh_ss(half);
+    #else
+      const std::uint32_t sign = std::uint32_t(half & 0x8000) << 16;
+      const std::uint32_t exponent = (half >> 10) & 0x1f;
+      const std::uint32_t mantissa = half & 0x3ff;
+      if (exponent == 0x1f)
+        return detail::BitsFloat(sign | 0x7f800000 | (mantissa << 13));
+      if (exponent == 0)
+      {
+        /// Zero or subnormal: mantissa * 2^-24
+        const float magnitude = mantissa * (1.f / (1u << 24));
+        return sign ? -magnitude : magnitude;
+      }
+      return detail::BitsFloat(sign | ((exponent + 112) << 23) |
+                               (mantissa << 13));
+    #endif
+  }
+
+  std::uint16_t bits;
+};
+
+
+struct BFloat16 {
+  BFloat16() = default;
+
+  BFloat16(float value)
+  : bits{FromFloat(value)}
+  { }
+
+  operator float() const { return ToFloat(bits); }
+
+  /// float -> bfloat16 bits, round to nearest even (NaNs stay NaN)
+  static std::uint16_t FromFloat(float value)
+  {
+    const std::uint32_t x = detail::FloatBits(value);
+    if ((x & 0x7fffffff) > 0x7f800000)
+      return static_cast<std::uint16_t>((x >> 16) | 0x40);
+    return static_cast<std::uint16_t>((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+  }
+
+  /// bfloat16 bits -> float (exact)
+  static float ToFloat(std::uint16_t bits)
+  {
+    return detail::BitsFloat(std::uint32_t(bits) << 16);
+  }
+
+  std::uint16_t bits;
+};
+
+
+static_assert(sizeof(Float16) == 2 && sizeof(BFloat16) == 2,
+              "16-bit float types must be 2 bytes!");
+
+
+/**
+ * True for the types which can store a coordinate: the built-in
+ * floating point types and the 16-bit types above
+ */
+template <typename T>
+struct IsStorageFloat : std::is_floating_point<T> { };
+template <>
+struct IsStorageFloat<Float16> : std::true_type { };
+template <>
+struct IsStorageFloat<BFloat16> : std::true_type { };
+
+
+/**
+ * The type in which values stored as T are computed with: float for
+ * the 16-bit types, T itself otherwise
+ */
+template <typename T>
+struct ComputeType { typedef T type; };
+template <>
+struct ComputeType<Float16> { typedef float type; };
+template <>
+struct ComputeType<BFloat16> { typedef float type; };
+
+
+#endif  // HALFFLOAT_H
+
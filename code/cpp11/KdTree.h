@@ -0,0 +1,282 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <algorithm> // std::nth_element
+#include <cmath>     // std::abs, std::isfinite
+#include <cstddef>   // std::size_t
+#include <limits>    // std::numeric_limits
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "DistanceKernels.h"
+#include "NearestK.h"
+#include "PointCloud2d.h"
+#include "TaskScheduler.h"
+
+
+/**
+ * A 2d tree over a point set, for nearest-neighbour queries at any
+ * query point under "Metric" (see Metrics.h); KdTree2d for the L1
+ * distance
+ *
+ * The tree has no nodes and no pointers: it is an implicit layout of
+ * the points themselves. The range [begin, end) of the coordinate
+ * arrays is a subtree; unless it holds at most kLeafSize points (a
+ * leaf), its middle point mid = begin + (end - begin) / 2 splits it
+ * into the subtrees [begin, mid) and [mid+1, end). Subtrees at even
+ * depth split on x, those at odd depth on y: all points on the left
+ * have a coordinate <= that of the middle point, all on the right one
+ * >= it. Building the tree just reorders the points (nth_element per
+ * subtree); leaves are contiguous runs of points, which are scanned
+ * with the SIMD kernels.
+ *
+ * A query descends into the subtree on the query point's side first,
+ * and visits the other side only if the distance from the query
+ * point to that side's cell (the metric applied to the distances to
+ * the split lines that separate them, along x and along y) does not
+ * exceed the best distance found so far. For points that are not
+ * pathologically clustered that is O(log n) expected time for
+ * Nearest(), and O(log n + k log k) for NearestK().
+ *
+ * Results follow NearestToOrigin and NearestKToOrigin: points are
+ * identified by their index in the original point set, and ordered by
+ * (distance, index). Points with a non-finite coordinate are left out
+ * of the tree.
+ */
+template <typename Metric>
+class BasicKdTree2d {
+public:
+  /// Most points in a leaf
+  static constexpr std::size_t kLeafSize = 32;
+  /// Subtrees with more points than this are built in parallel
+  static constexpr std::size_t kParallelBuildSize = std::size_t(1) << 16;
+
+  typedef std::vector<float, AlignedAllocator<float, kPointCloudAlignment>>
+          Column;
+
+  BasicKdTree2d() = default;
+
+  /// Build over "points" (anything with size(), x_data() and y_data())
+  template <typename Points>
+  explicit BasicKdTree2d(const Points& points)
+  {
+    Build(nullptr, points);
+  }
+
+  /// Build over "points", with the subtrees built in parallel
+  template <typename Points>
+  BasicKdTree2d(TaskScheduler& scheduler, const Points& points)
+  {
+    Build(&scheduler, points);
+  }
+
+  /// Number of points in the tree
+  std::size_t size() const { return x_.size(); }
+  bool empty() const { return x_.empty(); }
+
+  /**
+   * The point nearest to (qx, qy) and its distance; lowest index on
+   * ties. For an empty tree the index is
+   * std::numeric_limits<std::size_t>::max() and the distance is
+   * std::numeric_limits<float>::max().
+   */
+  Neighbor Nearest(float qx, float qy) const
+  {
+    NearestOne best;
+    Search(0, size(), 0, qx, qy, 0.f, 0.f, best);
+    return best.best;
+  }
+
+  /// Nearest() for the "count" query points (qx[i], qy[i]), in parallel
+  void Nearest(TaskScheduler& scheduler, const float* qx, const float* qy,
+               std::size_t count, Neighbor* nearest) const
+  {
+    ParallelForRange(scheduler, 0, count, kParallelQueryGrain,
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+          nearest[i] = Nearest(qx[i], qy[i]);
+      });
+  }
+
+  /**
+   * The (at most) k points nearest to (qx, qy), nearest first, lowest
+   * index first on ties
+   */
+  std::vector<Neighbor> NearestK(float qx, float qy, std::size_t k) const
+  {
+    NearestKHeap heap(k);
+    if (k > 0)
+      Search(0, size(), 0, qx, qy, 0.f, 0.f, heap);
+    return heap.Sorted();
+  }
+
+private:
+  /// Query points per task of the parallel Nearest()
+  static constexpr std::size_t kParallelQueryGrain = 1024;
+
+  /// A point while the tree is built
+  struct Entry {
+    float x;
+    float y;
+    std::size_t index;
+  };
+
+  /// Orders Entries by x (dimension 0) or y (dimension 1)
+  struct EntryLess {
+    unsigned dimension;
+    bool operator()(const Entry& a, const Entry& b) const
+    {
+      return dimension ? a.y < b.y : a.x < b.x;
+    }
+  };
+
+  /// The single best point, with NearestKHeap's interface
+  struct NearestOne {
+    NearestOne()
+    : best{std::numeric_limits<std::size_t>::max(),
+           std::numeric_limits<float>::max()}
+    { }
+
+    float limit() const { return best.distance; }
+
+    bool Offer(std::size_t index, float distance)
+    {
+      const Neighbor candidate{index, distance};
+      if (!(distance < std::numeric_limits<float>::max()) ||
+          !(candidate < best))
+        return false;
+      best = candidate;
+      return true;
+    }
+
+    Neighbor best;
+  };
+
+  template <typename Points>
+  void Build(TaskScheduler* scheduler, const Points& points)
+  {
+    std::vector<Entry> entries;
+    entries.reserve(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+      const float x = points.x_data()[i];
+      const float y = points.y_data()[i];
+      if (std::isfinite(x) && std::isfinite(y))
+        entries.push_back(Entry{x, y, i});
+    }
+
+    Arrange(scheduler, entries.data(), entries.data() + entries.size(), 0);
+
+    x_.resize(entries.size());
+    y_.resize(entries.size());
+    index_.resize(entries.size());
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+      x_[i] = entries[i].x;
+      y_[i] = entries[i].y;
+      index_[i] = entries[i].index;
+    }
+  }
+
+  /// Reorder [begin, end) into a subtree which splits on "dimension"
+  static void Arrange(TaskScheduler* scheduler, Entry* begin, Entry* end,
+                      unsigned dimension)
+  {
+    const std::size_t count = end - begin;
+    if (count <= kLeafSize)
+      return;
+    Entry* middle = begin + count / 2;
+    std::nth_element(begin, middle, end, EntryLess{dimension});
+    if (scheduler && count > kParallelBuildSize)
+      ParallelInvoke(*scheduler,
+                     [&]{ Arrange(scheduler, begin, middle, !dimension); },
+                     [&]{ Arrange(scheduler, middle+1, end, !dimension); });
+    else
+    {
+      Arrange(nullptr, begin, middle, !dimension);
+      Arrange(nullptr, middle+1, end, !dimension);
+    }
+  }
+
+  /**
+   * Offer the points of subtree [begin, end) that may beat best's
+   * limit() to "best". offset_x and offset_y are the distances from
+   * the query point to the subtree's cell along x and along y.
+   */
+  template <typename Best>
+  void Search(std::size_t begin, std::size_t end, unsigned dimension,
+              float qx, float qy, float offset_x, float offset_y,
+              Best& best) const
+  {
+    const std::size_t count = end - begin;
+    if (count <= kLeafSize)
+    {
+      float distances[kLeafSize];
+      DistanceToPoint<Metric>(x_.data() + begin, y_.data() + begin, count,
+                              qx, qy, distances);
+      for (std::size_t i = 0; i < count; ++i)
+        if (distances[i] <= best.limit())
+          best.Offer(index_[begin + i], distances[i]);
+      return;
+    }
+
+    const std::size_t middle = begin + count / 2;
+    /// Through the kernel, so that it rounds exactly like the leaves
+    float middle_distance;
+    DistanceToPoint<Metric>(x_.data() + middle, y_.data() + middle, 1,
+                            qx, qy, &middle_distance);
+    best.Offer(index_[middle], middle_distance);
+
+    const float difference = dimension ? qy - y_[middle] : qx - x_[middle];
+    const bool left_first = (difference < 0.f);
+    if (left_first)
+      Search(begin, middle, !dimension, qx, qy, offset_x, offset_y, best);
+    else
+      Search(middle+1, end, !dimension, qx, qy, offset_x, offset_y, best);
+
+    /// The far side's cell is "difference" away along this dimension.
+    /// The bound is computed like a point distance (no "- old offset"),
+    /// so that it rounds the same way and never exceeds one.
+    const float far_x = dimension ? offset_x : std::abs(difference);
+    const float far_y = dimension ? std::abs(difference) : offset_y;
+    if (!(Metric::Scalar(far_x, far_y) <= best.limit()))
+      return;
+    if (left_first)
+      Search(middle+1, end, !dimension, qx, qy, far_x, far_y, best);
+    else
+      Search(begin, middle, !dimension, qx, qy, far_x, far_y, best);
+  }
+
+  Column x_;
+  Column y_;
+  std::vector<std::size_t> index_;
+};
+
+typedef BasicKdTree2d<L1Metric> KdTree2d;
+
+
+#endif  // KDTREE_H
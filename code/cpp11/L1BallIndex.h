@@ -0,0 +1,262 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef L1BALLINDEX_H
+#define L1BALLINDEX_H
+
+#include <algorithm> // std::sort, std::min
+#include <cmath>     // std::abs, std::isfinite
+#include <cstddef>   // std::size_t
+#include <limits>    // std::numeric_limits
+#include <utility>   // std::move
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "DistanceKernels.h"
+#include "PointCloud2d.h"
+#include "WaveletMatrix.h"
+
+
+/**
+ * Counts of the points within an L1 radius of any centre, in
+ * O(log n) time per query (plus the few points within float rounding
+ * of the radius)
+ *
+ * In the coordinates u = x + y, v = x - y (the plane turned by 45
+ * degrees and scaled by sqrt(2)), the L1 distance becomes the maximum
+ * distance:
+ *
+ *   |x - qx| + |y - qy| = max(|u - qu|, |v - qv|)
+ *
+ * so the L1 ball around q is the axis-aligned square
+ * (qu - r, qu + r) x (qv - r, qv + r). The index sorts the points by
+ * u and stores, in that order, the rank of each point's v among all
+ * v's in a wavelet matrix (see WaveletMatrix.h). A query finds the u
+ * range as a range of positions and the v range as a range of ranks
+ * (two binary searches each), and the wavelet matrix counts the
+ * points in both: O(log n) steps, with about 8 + 16 + 0.25 log2(n)
+ * bytes per point (the coordinates by u, the v's and positions by v,
+ * the wavelet matrix).
+ *
+ * "Within" means what it means for CountNearPoint and GridIndex2d:
+ * the L1 distance, rounded to float, is less than the radius. u and v
+ * are computed in double, which is not quite the same, so the wavelet
+ * matrix only counts the points of a slightly smaller square, all of
+ * which are within the radius either way. The points of the thin
+ * border between that and a slightly larger square (those within
+ * float rounding of the radius) are checked one by one with the float
+ * kernel. Points with a non-finite coordinate are left out.
+ */
+class L1BallIndex {
+public:
+  typedef std::vector<float, AlignedAllocator<float, kPointCloudAlignment>>
+          Column;
+
+  L1BallIndex() = default;
+
+  /// Build over "points" (anything with size(), x_data() and y_data())
+  template <typename Points>
+  explicit L1BallIndex(const Points& points)
+  {
+    struct Rotated {
+      float x;
+      float y;
+      std::size_t position;
+    };
+    std::vector<Rotated> rotated;
+    rotated.reserve(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+      const float x = points.x_data()[i];
+      const float y = points.y_data()[i];
+      if (std::isfinite(x) && std::isfinite(y))
+        rotated.push_back(Rotated{x, y, 0});
+    }
+    const std::size_t count = rotated.size();
+
+    std::sort(rotated.begin(), rotated.end(),
+              [](const Rotated& a, const Rotated& b) {
+                return U(a.x, a.y) < U(b.x, b.y);
+              });
+    x_.resize(count);
+    y_.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      x_[i] = rotated[i].x;
+      y_[i] = rotated[i].y;
+      rotated[i].position = i;
+    }
+
+    /// Rank of every point's v (by u position), and the positions by v
+    std::sort(rotated.begin(), rotated.end(),
+              [](const Rotated& a, const Rotated& b) {
+                return V(a.x, a.y) < V(b.x, b.y);
+              });
+    std::vector<std::size_t> v_rank(count);
+    v_.resize(count);
+    position_by_v_.resize(count);
+    for (std::size_t rank = 0; rank < count; ++rank)
+    {
+      v_rank[rotated[rank].position] = rank;
+      v_[rank] = V(rotated[rank].x, rotated[rank].y);
+      position_by_v_[rank] = rotated[rank].position;
+    }
+
+    ranks_ = WaveletMatrix(std::move(v_rank));
+  }
+
+  /// Number of points in the index
+  std::size_t size() const { return x_.size(); }
+  bool empty() const { return x_.empty(); }
+
+  /**
+   * Number of points with an L1 distance to (qx, qy) less than
+   * "radius"; the same as CountNearPoint() on the points
+   */
+  std::size_t CountWithin(float qx, float qy, float radius) const
+  {
+    if (!(radius > 0.f) || !std::isfinite(qx) || !std::isfinite(qy))
+      return 0;
+
+    /// The float distance of a point is within 2^-22 (relative) of its
+    /// exact distance, and the double u and v of a point near q are
+    /// within far less than 2^-48 (|qx| + |qy| + radius) of exact. So
+    /// the points of the "inner" square are all within the radius, and
+    /// no point outside the "outer" one is.
+    const double limit = std::min(double(radius),
+                                  double(std::numeric_limits<float>::max()));
+    const double margin = limit * kRelativeMargin +
+                          (std::abs(double(qx)) + std::abs(double(qy)) +
+                           limit) * kAbsoluteMargin;
+    const double inner = limit - margin;
+    const double outer = double(radius) + margin;
+
+    const double qu = U(qx, qy);
+    const double qv = V(qx, qy);
+    const auto u = [this](std::size_t position) {
+      return U(x_[position], y_[position]);
+    };
+    const auto v = [this](std::size_t rank) { return v_[rank]; };
+    std::size_t u_outer_begin;
+    std::size_t u_outer_end;
+    std::size_t u_inner_begin;
+    std::size_t u_inner_end;
+    std::size_t v_outer_begin;
+    std::size_t v_outer_end;
+    std::size_t v_inner_begin;
+    std::size_t v_inner_end;
+    OpenIntervals(u, size(), qu, outer, inner, u_outer_begin, u_outer_end,
+                  u_inner_begin, u_inner_end);
+    OpenIntervals(v, size(), qv, outer, inner, v_outer_begin, v_outer_end,
+                  v_inner_begin, v_inner_end);
+
+    std::size_t count = ranks_.CountBetween(u_inner_begin, u_inner_end,
+                                            v_inner_begin, v_inner_end);
+    /// The border: u near qu +- radius ...
+    count += CountNearPoint(x_.data() + u_outer_begin,
+                            y_.data() + u_outer_begin,
+                            u_inner_begin - u_outer_begin, qx, qy, radius);
+    count += CountNearPoint(x_.data() + u_inner_end, y_.data() + u_inner_end,
+                            u_outer_end - u_inner_end, qx, qy, radius);
+    /// ... and v near qv +- radius, with u inside
+    const auto count_v_border = [&](std::size_t begin, std::size_t end) {
+      for (std::size_t rank = begin; rank < end; ++rank)
+      {
+        const std::size_t position = position_by_v_[rank];
+        if (position >= u_inner_begin && position < u_inner_end)
+          count += CountNearPoint(x_.data() + position, y_.data() + position,
+                                  1, qx, qy, radius);
+      }
+    };
+    count_v_border(v_outer_begin, v_inner_begin);
+    count_v_border(v_inner_end, v_outer_end);
+    return count;
+  }
+
+private:
+  static constexpr double kRelativeMargin = 1. / (1 << 21);
+  static constexpr double kAbsoluteMargin = 1. / (1ull << 48);
+
+  /// The rotated coordinates of (x, y)
+  static double U(float x, float y) { return double(x) + y; }
+  static double V(float x, float y) { return double(x) - y; }
+
+  /**
+   * The positions [outer_begin, outer_end) of the values w = value(i),
+   * sorted by i in [0, count), with |w - centre| < outer, and the
+   * positions [inner_begin, inner_end) (inside those) with
+   * |w - centre| < inner
+   */
+  template <typename Value>
+  static void OpenIntervals(const Value& value, std::size_t count,
+                            double centre, double outer, double inner,
+                            std::size_t& outer_begin, std::size_t& outer_end,
+                            std::size_t& inner_begin, std::size_t& inner_end)
+  {
+    /// w - centre is monotonic in w (also after rounding)
+    outer_begin = PartitionPoint(0, count, [&](std::size_t i) {
+                    return !(value(i) - centre > -outer);
+                  });
+    outer_end = PartitionPoint(outer_begin, count, [&](std::size_t i) {
+                  return value(i) - centre < outer;
+                });
+    /// Only the few values within rounding of the radius lie between
+    /// the two intervals, so walk instead of searching
+    inner_begin = outer_begin;
+    while (inner_begin < outer_end &&
+           !(value(inner_begin) - centre > -inner))
+      ++inner_begin;
+    inner_end = outer_end;
+    while (inner_end > inner_begin && !(value(inner_end - 1) - centre < inner))
+      --inner_end;
+  }
+
+  /// The first i in [first, last) for which "before" is false, given
+  /// that it is true exactly for a prefix
+  template <typename Before>
+  static std::size_t PartitionPoint(std::size_t first, std::size_t last,
+                                    const Before& before)
+  {
+    while (first < last)
+    {
+      const std::size_t middle = first + (last - first) / 2;
+      if (before(middle))
+        first = middle + 1;
+      else
+        last = middle;
+    }
+    return first;
+  }
+
+  /// The points by u
+  Column x_;
+  Column y_;
+  /// The v's, sorted, and the positions (in x_, y_) of their points
+  std::vector<double> v_;
+  std::vector<std::size_t> position_by_v_;
+  WaveletMatrix ranks_;
+};
+
+
+#endif  // L1BALLINDEX_H
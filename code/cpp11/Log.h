@@ -0,0 +1,134 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdint>   // std::uint64_t
+#include <cstdio>    // std::fwrite, stderr
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+
+/**
+ * Logging with compile-time levels
+ *
+ *   LOG(INFO) << "Loaded " << count << " points";
+ *   LOG_EVERY_N(DEBUG, 1000) << "New point " << point;
+ *
+ * Messages below LOG_LEVEL are removed at compile time: the condition
+ * of the macro is a constant, so the compiler drops the whole
+ * statement, and the stream operands are never evaluated. Pick the
+ * level when building, e.g.
+ *
+ *   make CXXFLAGS="-DLOG_LEVEL=LOG_LEVEL_DEBUG ..."
+ *
+ * LOG_EVERY_N logs only the 1st, (N+1)-th, (2N+1)-th, ... time that
+ * statement is reached (counted per statement, across all threads;
+ * never for N = 0), for events on hot paths. Enabled messages are
+ * formatted into a buffer and go to stderr in one write each, so
+ * lines from different threads do not interleave.
+ */
+#define LOG_LEVEL_TRACE    0
+#define LOG_LEVEL_DEBUG    1
+#define LOG_LEVEL_INFO     2
+#define LOG_LEVEL_WARNING  3
+#define LOG_LEVEL_ERROR    4
+#define LOG_LEVEL_OFF      5
+
+#ifndef LOG_LEVEL
+  #define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+
+/**
+ * One log line; written out by the destructor
+ */
+class LogMessage {
+public:
+  LogMessage(const char* severity, const char* file, int line)
+  {
+    stream_ << "[" << severity << "] " << file << ":" << line << ": ";
+  }
+
+  ~LogMessage()
+  {
+    stream_ << '\n';
+    const std::string text = stream_.str();
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fwrite(text.data(), 1, text.size(), stderr);
+  }
+
+  LogMessage(const LogMessage&) = delete;
+  LogMessage& operator=(const LogMessage&) = delete;
+
+  std::ostream& stream() { return stream_; }
+
+private:
+  std::ostringstream stream_;
+};
+
+
+/**
+ * Turns "LogVoidify() & stream << ..." into a void expression, so
+ * that the macros can be ?: expressions (which, unlike an if/else,
+ * cannot swallow a caller's "else")
+ */
+struct LogVoidify {
+  void operator&(std::ostream&) { }
+};
+
+
+/// True on the 1st, (n+1)-th, ... call with the same "counter"; never
+/// for n == 0
+inline bool LogSample(std::atomic<std::uint64_t>& counter, std::uint64_t n)
+{
+  if (n == 0)
+    return false;
+  return counter.fetch_add(1, std::memory_order_relaxed) % n == 0;
+}
+
+
+#define LOG(severity)                                                    \
+  (LOG_LEVEL_##severity < LOG_LEVEL)                                     \
+    ? (void)0                                                            \
+    : LogVoidify() & LogMessage(#severity, __FILE__, __LINE__).stream()
+
+/// Every expansion has its own lambda type, and so its own counter
+#define LOG_EVERY_N(severity, n)                                         \
+  (LOG_LEVEL_##severity < LOG_LEVEL ||                                   \
+   !LogSample([]() -> std::atomic<std::uint64_t>& {                      \
+                static std::atomic<std::uint64_t> counter{0};            \
+                return counter;                                          \
+              }(), (n)))                                                 \
+    ? (void)0                                                            \
+    : LogVoidify() & LogMessage(#severity, __FILE__, __LINE__).stream()
+
+
+#endif  // LOG_H
+
@@ -0,0 +1,127 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cmath>     // std::abs, std::sqrt
+
+#include "Simd.h"
+
+
+/**
+ * Distance metrics for the kernels in DistanceKernels.h, as
+ * compile-time policies
+ *
+ * A metric is a type with two static functions which turn the
+ * coordinate differences (dx, dy) of a point to the query point (the
+ * coordinates themselves for the origin) into a distance:
+ *
+ *   static float Scalar(float dx, float dy);
+ *   static simd::Float Vector(simd::Float dx, simd::Float dy);
+ *
+ * Vector() computes simd::kWidth distances at once, and both give
+ * bit-identical results. The kernels take the metric as a template
+ * parameter (L1Metric by default), so every metric gets its own fully
+ * inlined kernel, without any call per point:
+ *
+ *   CountNearOrigin<L2Metric>(points, 0.5f);
+ *   NearestToOrigin<ChebyshevMetric>(points);
+ *
+ * Every distance is >= 0, or NaN if a difference is NaN (such points
+ * are never near nor nearest). Metrics must not decrease when |dx| or
+ * |dy| grows, which the pruning of the trees relies on.
+ */
+
+
+/// |dx| + |dy| (Manhattan distance)
+struct L1Metric {
+  static float Scalar(float dx, float dy)
+  {
+    return std::abs(dx) + std::abs(dy);
+  }
+  static simd::Float Vector(simd::Float dx, simd::Float dy)
+  {
+    return simd::Add(simd::Abs(dx), simd::Abs(dy));
+  }
+};
+
+
+/**
+ * dx*dx + dy*dy, the square of the Euclidean distance: the same order
+ * as L2Metric without the square root, so thresholds are squared as
+ * well. The sum is a (fused, where the CPU has it) multiply-add, see
+ * simd::MulAdd. Overflows to infinity for differences above about
+ * 1.8e19.
+ */
+struct SquaredL2Metric {
+  static float Scalar(float dx, float dy)
+  {
+    return simd::ScalarMulAdd(dx, dx, dy * dy);
+  }
+  static simd::Float Vector(simd::Float dx, simd::Float dy)
+  {
+    return simd::MulAdd(dx, dx, simd::Mul(dy, dy));
+  }
+};
+
+
+/// sqrt(dx*dx + dy*dy) (Euclidean distance); infinite where
+/// SquaredL2Metric overflows
+struct L2Metric {
+  static float Scalar(float dx, float dy)
+  {
+    return std::sqrt(SquaredL2Metric::Scalar(dx, dy));
+  }
+  static simd::Float Vector(simd::Float dx, simd::Float dy)
+  {
+    return simd::Sqrt(SquaredL2Metric::Vector(dx, dy));
+  }
+};
+
+
+/**
+ * max(|dx|, |dy|) (Chebyshev or maximum distance). simd::Max drops a
+ * NaN operand, so the maximum is taken as min(max, |dx| + |dy|): the
+ * sum is never smaller than the maximum, and it is NaN if either is.
+ */
+struct ChebyshevMetric {
+  static float Scalar(float dx, float dy)
+  {
+    const float ax = std::abs(dx);
+    const float ay = std::abs(dy);
+    const float larger = (ax > ay) ? ax : ay;
+    const float sum = ax + ay;
+    return (larger < sum) ? larger : sum;
+  }
+  static simd::Float Vector(simd::Float dx, simd::Float dy)
+  {
+    const simd::Float ax = simd::Abs(dx);
+    const simd::Float ay = simd::Abs(dy);
+    return simd::Min(simd::Max(ax, ay), simd::Add(ax, ay));
+  }
+};
+
+
+#endif  // METRICS_H
@@ -0,0 +1,288 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NEARESTK_H
+#define NEARESTK_H
+
+#include <algorithm> // std::push_heap, std::pop_heap, std::sort_heap, ...
+#include <atomic>
+#include <cmath>     // std::nextafter
+#include <cstddef>   // std::size_t
+#include <iterator>  // std::back_inserter
+#include <limits>    // std::numeric_limits
+#include <vector>
+
+#include "DistanceKernels.h"
+#include "PointCloud2d.h"
+#include "Simd.h"
+
+
+/**
+ * The k points nearest to the origin
+ *
+ * Sorting all n distances costs O(n log n) time and O(n) memory.
+ * NearestKToOrigin() instead keeps the k best points seen so far in a
+ * bounded max-heap; its top, the k-th best distance, is the limit a
+ * later point has to meet to get in. Once the heap is full almost no
+ * point does, so the scan compares a whole SIMD vector of distances
+ * against the limit at once and only looks at single lanes (and the
+ * heap) if at least one of them passes. That is O(n) vector compares
+ * plus O(m log k) for the m points that make it into the heap, where
+ * m is about k (1 + ln(n/k)) for points in random order.
+ *
+ * Points are ordered by (distance, index): of equally distant points
+ * the lower index comes first, so the result is the first k entries
+ * of a stable sort by distance. As for NearestToOrigin, only points
+ * with a distance less than std::numeric_limits<float>::max() count.
+ */
+
+
+/// A point (by index) and its distance
+struct Neighbor {
+  std::size_t index;
+  float distance;
+};
+
+
+/// Order by distance, then by index
+inline bool operator<(const Neighbor& a, const Neighbor& b)
+{
+  return a.distance < b.distance ||
+         (a.distance == b.distance && a.index < b.index);
+}
+
+
+/**
+ * The k smallest Neighbors offered to it, in a max-heap
+ */
+class NearestKHeap {
+public:
+  explicit NearestKHeap(std::size_t k)
+  : k_{k}
+  { }
+
+  std::size_t k() const { return k_; }
+  std::size_t size() const { return heap_.size(); }
+
+  /**
+   * Points with a distance above limit() cannot get in any more
+   * (those at exactly limit() may, if their index is lower than that
+   * of the current k-th point)
+   */
+  float limit() const
+  {
+    if (heap_.size() < k_)
+      return std::numeric_limits<float>::max();
+    return (k_ > 0) ? heap_.front().distance
+                    : -std::numeric_limits<float>::infinity();
+  }
+
+  /// Add the point if it is among the k best so far; true if it was
+  bool Offer(std::size_t index, float distance)
+  {
+    const Neighbor candidate{index, distance};
+    if (heap_.size() < k_)
+    {
+      if (!(distance < std::numeric_limits<float>::max()))
+        return false;
+      heap_.push_back(candidate);
+      std::push_heap(heap_.begin(), heap_.end());
+      return true;
+    }
+    if (k_ == 0 || !(candidate < heap_.front()))
+      return false;
+    std::pop_heap(heap_.begin(), heap_.end());
+    heap_.back() = candidate;
+    std::push_heap(heap_.begin(), heap_.end());
+    return true;
+  }
+
+  /// The Neighbors in the heap, nearest first
+  std::vector<Neighbor> Sorted() const
+  {
+    std::vector<Neighbor> sorted(heap_);
+    std::sort_heap(sorted.begin(), sorted.end());
+    return sorted;
+  }
+
+private:
+  std::size_t k_;
+  std::vector<Neighbor> heap_;
+};
+
+
+/**
+ * A distance limit shared by the heaps of a parallel k-nearest query
+ *
+ * A chunk whose heap is full has found k points at or below its
+ * limit(), so no point farther away than that can be among the k
+ * nearest of the whole set. Every chunk publishes its limit here and
+ * also filters against the smallest one published, which quickly
+ * stops the other chunks from filling their heaps with points that a
+ * merge would drop anyway. The final result does not depend on the
+ * timing: it is still exactly the first k points by (distance, index).
+ */
+class SharedDistanceLimit {
+public:
+  SharedDistanceLimit()
+  : limit_{std::numeric_limits<float>::max()}
+  { }
+
+  float load() const { return limit_.load(std::memory_order_relaxed); }
+
+  /// Lower the limit to "limit" (if that is lower)
+  void Lower(float limit)
+  {
+    float current = load();
+    while (limit < current &&
+           !limit_.compare_exchange_weak(current, limit,
+                                         std::memory_order_relaxed))
+    { }
+  }
+
+private:
+  std::atomic<float> limit_;
+};
+
+
+namespace detail {
+
+  /**
+   * Offer the distances load(0 .. count-1) to "heap", as points
+   * first_index + 0 .. count-1. With a "shared" limit, only points at
+   * or below it are offered, and the heap's own limit is published
+   * to it whenever the heap is full.
+   */
+  template <typename Loader>
+  void OfferNearestK(const Loader& load, std::size_t count,
+                     std::size_t first_index, NearestKHeap& heap,
+                     SharedDistanceLimit* shared = nullptr)
+  {
+    /// Points between two looks at the shared limit
+    constexpr std::size_t kRefreshInterval = 1024;
+
+    if (heap.k() == 0)
+      return;
+
+    std::size_t i = 0;
+    while (i < count)
+    {
+      const std::size_t block_end = (count - i > kRefreshInterval)
+                                    ? i + kRefreshInterval : count;
+      float limit = heap.limit();
+      if (shared && shared->load() < limit)
+        limit = shared->load();
+      /// "distance <= limit" as a strict compare, which the SIMD
+      /// units have (and which NaNs fail)
+      simd::Float bar = simd::Set1(
+          std::nextafter(limit, std::numeric_limits<float>::infinity()));
+
+      for (; i + simd::kWidth <= block_end; i += simd::kWidth)
+      {
+        const simd::Float distance = load.Vector(i);
+        if (simd::CountTrue(simd::Less(distance, bar)) == 0)
+          continue;
+
+        float distances[simd::kWidth];
+        simd::Store(distances, distance);
+        bool changed = false;
+        for (std::size_t lane = 0; lane < simd::kWidth; ++lane)
+          if (distances[lane] <= limit &&
+              heap.Offer(first_index + i + lane, distances[lane]))
+          {
+            changed = true;
+            if (heap.limit() < limit)
+              limit = heap.limit();
+          }
+        if (changed)
+        {
+          if (shared && heap.size() == heap.k())
+            shared->Lower(limit);
+          bar = simd::Set1(
+              std::nextafter(limit, std::numeric_limits<float>::infinity()));
+        }
+      }
+      for (; i < block_end; ++i)
+      {
+        const float distance = load.Scalar(i);
+        if (distance <= limit && heap.Offer(first_index + i, distance) &&
+            heap.limit() < limit)
+        {
+          limit = heap.limit();
+          if (shared && heap.size() == heap.k())
+            shared->Lower(limit);
+        }
+      }
+    }
+  }
+
+  /// The first k of two sorted Neighbor lists
+  inline std::vector<Neighbor> MergeNearestK(const std::vector<Neighbor>& a,
+                                             const std::vector<Neighbor>& b,
+                                             std::size_t k)
+  {
+    std::vector<Neighbor> merged;
+    merged.reserve(std::min(a.size() + b.size(), k));
+    std::merge(a.begin(), a.end(), b.begin(), b.end(),
+               std::back_inserter(merged));
+    if (merged.size() > k)
+      merged.resize(k);
+    return merged;
+  }
+
+}  // namespace detail
+
+
+/**
+ * The (at most) k points i in [0, count) nearest to the origin under
+ * "Metric" (by default the L1 distance |x[i]| + |y[i]|), nearest
+ * first, lower index first on ties
+ */
+template <typename Metric = L1Metric, typename T>
+std::vector<Neighbor> NearestKToOrigin(const T* x, const T* y,
+                                       std::size_t count, std::size_t k)
+{
+  static_assert(IsKernelCoordinate<T>::value,
+                "'NearestKToOrigin' kernel needs float or 16-bit floats!");
+  NearestKHeap heap(k);
+  detail::OfferNearestK(detail::DistanceLoader<Metric, T>{x, y}, count, 0,
+                        heap);
+  return heap.Sorted();
+}
+
+
+/**
+ * The (at most) k points of "points" nearest to the origin, nearest
+ * first; see NearestKToOrigin above
+ */
+template <typename Metric = L1Metric, typename T>
+std::vector<Neighbor> NearestKToOrigin(const BasicPointCloud2d<T>& points,
+                                       std::size_t k)
+{
+  return NearestKToOrigin<Metric>(points.x_data(), points.y_data(),
+                                  points.size(), k);
+}
+
+
+#endif  // NEARESTK_H
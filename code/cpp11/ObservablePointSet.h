@@ -0,0 +1,266 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OBSERVABLEPOINTSET_H
+#define OBSERVABLEPOINTSET_H
+
+#include <algorithm> // std::sort, std::unique
+#include <cmath>     // std::abs
+#include <cstddef>   // std::size_t
+#include <limits>    // std::numeric_limits
+#include <vector>
+
+#include "DistanceKernels.h"
+#include "NearestK.h"
+#include "PointCloud2d.h"
+
+
+/**
+ * A point set which keeps its near-origin count and its point nearest
+ * to the origin up to date while points move
+ *
+ * Points only change through Set() (or push_back()), so the set sees
+ * every move. The near-origin count is adjusted right away from the
+ * point's old and new distance, O(1). The nearest point is the winner
+ * of a tournament tree over the distances: every inner node holds the
+ * better of its two children, the root the best of all. Set() only
+ * marks the point dirty; the next Nearest() replays the matches on
+ * the paths from the dirty points to the root, level by level so that
+ * shared ancestors are replayed once (O(d log n) for d dirty points,
+ * or O(n) when that is less), and then reads the root:
+ *
+ *   ObservablePointSet points(cloud);       // O(n)
+ *   points.Set(i, x, y);                    // O(1)
+ *   points.CountNear();                     // O(1)
+ *   points.Nearest();                       // O(1) + pending updates
+ *
+ * Distances follow the kernels: float L1 distances, "near" is less
+ * than threshold(), and Nearest() takes the lowest index on ties and
+ * only distances below std::numeric_limits<float>::max().
+ *
+ * Not thread safe: Nearest() is const but replays pending updates.
+ */
+class ObservablePointSet {
+public:
+  /// An empty set, counting points nearer than "threshold"
+  explicit ObservablePointSet(float threshold = 0.5f)
+  : threshold_{threshold}, near_{0}
+  {
+    Rebuild();
+  }
+
+  /// A copy of "points" (anything with size(), x_data() and y_data())
+  template <typename Points>
+  explicit ObservablePointSet(const Points& points, float threshold = 0.5f)
+  : threshold_{threshold}, near_{0}
+  {
+    const std::size_t count = points.size();
+    points_.resize(count);
+    distances_.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      points_.x(i) = float(points.x_data()[i]);
+      points_.y(i) = float(points.y_data()[i]);
+    }
+    ManhattanToOrigin(points_.x_data(), points_.y_data(), count,
+                      distances_.data());
+    for (std::size_t i = 0; i < count; ++i)
+      near_ += (distances_[i] < threshold_);
+    Rebuild();
+  }
+
+  std::size_t size() const { return points_.size(); }
+  bool empty() const { return points_.empty(); }
+
+  float threshold() const { return threshold_; }
+
+  /// Coordinates of point "index", and the coordinate columns
+  float x(std::size_t index) const { return points_.x(index); }
+  float y(std::size_t index) const { return points_.y(index); }
+  const float* x_data() const { return points_.x_data(); }
+  const float* y_data() const { return points_.y_data(); }
+
+  /// L1 distance of point "index" to the origin
+  float distance(std::size_t index) const { return distances_[index]; }
+
+  /// Add the point (x, y) as point size()
+  void push_back(float x, float y)
+  {
+    const std::size_t index = size();
+    points_.push_back(x, y);
+    distances_.push_back(Distance(x, y));
+    is_dirty_.push_back(0);
+    near_ += (distances_[index] < threshold_);
+    if (index < capacity_)
+    {
+      winners_[capacity_ + index] = index;
+      MarkDirty(index);
+    }
+    else
+      Rebuild();
+  }
+
+  /// Move point "index" to (x, y)
+  void Set(std::size_t index, float x, float y)
+  {
+    const float distance = Distance(x, y);
+    near_ -= (distances_[index] < threshold_);
+    near_ += (distance < threshold_);
+    points_.x(index) = x;
+    points_.y(index) = y;
+    distances_[index] = distance;
+    MarkDirty(index);
+  }
+
+  /// Number of points with a distance less than threshold()
+  std::size_t CountNear() const { return near_; }
+
+  /**
+   * The point nearest to the origin and its distance; without one
+   * (e.g. for an empty set) the index is size() and the distance is
+   * std::numeric_limits<float>::max()
+   */
+  Neighbor Nearest() const
+  {
+    Flush();
+    const std::size_t winner = winners_[1];
+    if (winner == kNone || !(Key(winner) < kNoDistance))
+      return Neighbor{size(), std::numeric_limits<float>::max()};
+    return Neighbor{winner, distances_[winner]};
+  }
+
+private:
+  /// Tournament tree entry of a leaf without a point
+  static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+  /// Key of a point that can not be the nearest
+  static constexpr float kNoDistance = std::numeric_limits<float>::infinity();
+
+  static float Distance(float x, float y)
+  {
+    return std::abs(x) + std::abs(y);
+  }
+
+  /// Distance of point "index" as compared in the tree: too far
+  /// (including NaN) is kNoDistance
+  float Key(std::size_t index) const
+  {
+    const float distance = distances_[index];
+    return (distance < std::numeric_limits<float>::max()) ? distance
+                                                           : kNoDistance;
+  }
+
+  /// The winner of a match between the entries "a" and "b"
+  std::size_t Winner(std::size_t a, std::size_t b) const
+  {
+    if (a == kNone)
+      return b;
+    if (b == kNone)
+      return a;
+    const float key_a = Key(a);
+    const float key_b = Key(b);
+    if (key_a < key_b || (key_a == key_b && a < b))
+      return a;
+    return b;
+  }
+
+  void MarkDirty(std::size_t index)
+  {
+    if (!is_dirty_[index])
+    {
+      is_dirty_[index] = 1;
+      dirty_.push_back(index);
+    }
+  }
+
+  /// Size the tree for the points (the next power of two), and play
+  /// all matches
+  void Rebuild()
+  {
+    capacity_ = 1;
+    depth_ = 0;
+    while (capacity_ < size())
+    {
+      capacity_ *= 2;
+      ++depth_;
+    }
+    winners_.assign(2 * capacity_, std::size_t(kNone));
+    for (std::size_t i = 0; i < size(); ++i)
+      winners_[capacity_ + i] = i;
+    for (std::size_t node = capacity_ - 1; node > 0; --node)
+      winners_[node] = Winner(winners_[2*node], winners_[2*node+1]);
+    is_dirty_.assign(size(), 0);
+    dirty_.clear();
+  }
+
+  /// Replay the matches above the dirty points
+  void Flush() const
+  {
+    if (dirty_.empty())
+      return;
+    for (std::size_t index: dirty_)
+      is_dirty_[index] = 0;
+    if (dirty_.size() * depth_ >= capacity_)
+    {
+      for (std::size_t node = capacity_ - 1; node > 0; --node)
+        winners_[node] = Winner(winners_[2*node], winners_[2*node+1]);
+    }
+    else
+    {
+      /// Sorted parents of the dirty nodes, one level at a time
+      std::sort(dirty_.begin(), dirty_.end());
+      for (std::size_t& node: dirty_)
+        node = (capacity_ + node) / 2;
+      dirty_.erase(std::unique(dirty_.begin(), dirty_.end()), dirty_.end());
+      while (!dirty_.empty() && dirty_.front() > 0)
+      {
+        for (std::size_t& node: dirty_)
+        {
+          winners_[node] = Winner(winners_[2*node], winners_[2*node+1]);
+          node /= 2;
+        }
+        dirty_.erase(std::unique(dirty_.begin(), dirty_.end()),
+                     dirty_.end());
+      }
+    }
+    dirty_.clear();
+  }
+
+  float threshold_;
+  std::size_t near_;
+  PointCloud2d points_;
+  std::vector<float> distances_;
+
+  /// Tournament tree: leaf i is winners_[capacity_ + i], inner node k
+  /// (from 1, the root) has the children 2k and 2k+1
+  mutable std::vector<std::size_t> winners_;
+  std::size_t capacity_;
+  /// log2(capacity_)
+  std::size_t depth_;
+  /// Points moved since the last Flush(), and which ones they are
+  mutable std::vector<std::size_t> dirty_;
+  mutable std::vector<unsigned char> is_dirty_;
+};
+
+
+#endif  // OBSERVABLEPOINTSET_H
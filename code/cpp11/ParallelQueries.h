@@ -0,0 +1,380 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PARALLELQUERIES_H
+#define PARALLELQUERIES_H
+
+#include <algorithm> // std::min, std::max
+#include <cstddef>   // std::size_t
+#include <limits>    // std::numeric_limits
+#include <tuple>
+#include <vector>
+
+#include "DistanceKernels.h"
+#include "NearestK.h"
+#include "PointCloud2d.h"
+#include "ScanEngine.h"
+#include "TaskScheduler.h"
+#include "ThreadPool.h"
+
+
+/**
+ * Multithreaded versions of the point queries
+ *
+ * The points are cut into chunks of kParallelChunkSize points, each
+ * chunk is reduced on its own by whichever thread of the pool takes
+ * it, and the per-chunk results are merged in chunk order at the end.
+ * The chunk boundaries do not depend on the number of threads, and
+ * the merge is done in index order, so the results are exactly those
+ * of the single-threaded versions, for any pool size. The exception is
+ * a Scan() with SumDistance: the chunk totals are added up on their
+ * own and then merged, a different order of additions than the one
+ * running total of the single-threaded Scan(), so the sums agree only
+ * up to rounding.
+ *
+ * Every query exists twice: once for the ThreadPool (a flat loop over
+ * the chunks) and once for the work-stealing TaskScheduler (a
+ * recursive fork/join split over the chunks).
+ *
+ * "Points" is any point set with size(), x_data() and y_data(): a
+ * PointCloud2d (or a 16-bit one, except for Scan()), or a
+ * MappedPointCloud2d (see PointFile.h). Like their single-threaded
+ * versions, the queries take the metric as an optional first template
+ * parameter (see Metrics.h), e.g. CountNearOrigin<L2Metric>(pool,
+ * points).
+ *
+ * NearestKToOrigin() is the exception: a chunk-sized heap of k points
+ * would have to be rebuilt for every chunk, so it splits the points
+ * into a few runs of chunks per thread instead, each with one heap.
+ * The heaps also share a distance limit (see NearestK.h). Both only
+ * prune points that cannot be in the result, so it is the same for
+ * any pool size as well.
+ */
+
+
+/// Points per chunk (512 KB of coordinates)
+constexpr std::size_t kParallelChunkSize = std::size_t(1) << 16;
+
+/// Runs of chunks per thread for NearestKToOrigin
+constexpr std::size_t kNearestKRunsPerThread = 4;
+
+
+inline std::size_t ParallelChunkCount(std::size_t count)
+{
+  return (count + kParallelChunkSize - 1) / kParallelChunkSize;
+}
+
+
+/**
+ * Multithreaded NearestToOrigin (same result and tie-breaking)
+ */
+template <typename Metric = L1Metric, typename Points>
+std::tuple<std::size_t, float> NearestToOrigin(
+                          ThreadPool& pool,
+                          const Points& points
+                                              )
+{
+  const std::size_t count = points.size();
+  const std::size_t chunks = ParallelChunkCount(count);
+  std::vector<std::tuple<std::size_t, float>> partial(chunks);
+  pool.ParallelFor(chunks, [&](std::size_t chunk) {
+    const std::size_t begin = chunk * kParallelChunkSize;
+    const std::size_t end = std::min(begin + kParallelChunkSize, count);
+    partial[chunk] = NearestToOrigin<Metric>(points.x_data() + begin,
+                                             points.y_data() + begin,
+                                             end - begin);
+    std::get<0>(partial[chunk]) += begin;
+  });
+
+  /// Strictly smaller only: on ties the earlier chunk wins
+  std::size_t min_index = count;
+  float min_distance = std::numeric_limits<float>::max();
+  for (std::size_t chunk = 0; chunk < chunks; ++chunk)
+  {
+    const std::size_t chunk_end = std::min((chunk+1) * kParallelChunkSize,
+                                           count);
+    if (std::get<0>(partial[chunk]) < chunk_end &&
+        std::get<1>(partial[chunk]) < min_distance)
+      std::tie(min_index, min_distance) = partial[chunk];
+  }
+
+  return std::make_tuple(min_index, min_distance);
+}
+
+
+namespace detail {
+
+  /// The k nearest of points [begin, end) (by absolute index) which
+  /// are not farther away than "shared" allows, nearest first
+  template <typename Metric, typename T>
+  std::vector<Neighbor> NearestKInRange(const T* x, const T* y,
+                                        std::size_t begin, std::size_t end,
+                                        std::size_t k,
+                                        SharedDistanceLimit& shared)
+  {
+    NearestKHeap heap(k);
+    OfferNearestK(DistanceLoader<Metric, T>{x + begin, y + begin},
+                  end - begin, begin, heap, &shared);
+    return heap.Sorted();
+  }
+
+}  // namespace detail
+
+
+/**
+ * Multithreaded CountNearOrigin
+ */
+template <typename Metric = L1Metric, typename Points>
+std::size_t CountNearOrigin(ThreadPool& pool,
+                            const Points& points,
+                            float threshold = 0.5f)
+{
+  const std::size_t count = points.size();
+  const std::size_t chunks = ParallelChunkCount(count);
+  std::vector<std::size_t> partial(chunks);
+  pool.ParallelFor(chunks, [&](std::size_t chunk) {
+    const std::size_t begin = chunk * kParallelChunkSize;
+    const std::size_t end = std::min(begin + kParallelChunkSize, count);
+    partial[chunk] = CountNearOrigin<Metric>(points.x_data() + begin,
+                                             points.y_data() + begin,
+                                             end - begin, threshold);
+  });
+
+  std::size_t near = 0;
+  for (auto chunk_count: partial)
+    near += chunk_count;
+  return near;
+}
+
+
+/**
+ * Multithreaded NearestKToOrigin (same result and tie-breaking)
+ */
+template <typename Metric = L1Metric, typename Points>
+std::vector<Neighbor> NearestKToOrigin(ThreadPool& pool,
+                                       const Points& points,
+                                       std::size_t k)
+{
+  const std::size_t count = points.size();
+  const std::size_t chunks = ParallelChunkCount(count);
+  const std::size_t runs = std::min(chunks,
+                                    kNearestKRunsPerThread * pool.size());
+  std::vector<std::vector<Neighbor>> partial(runs);
+  SharedDistanceLimit limit;
+  pool.ParallelFor(runs, [&](std::size_t run) {
+    const std::size_t begin = (chunks * run / runs) * kParallelChunkSize;
+    const std::size_t end = std::min((chunks * (run+1) / runs)
+                                     * kParallelChunkSize, count);
+    partial[run] = detail::NearestKInRange<Metric>(points.x_data(),
+                                                   points.y_data(),
+                                                   begin, end, k, limit);
+  });
+
+  std::vector<Neighbor> nearest;
+  for (const auto& run_nearest: partial)
+    nearest = detail::MergeNearestK(nearest, run_nearest, k);
+  return nearest;
+}
+
+
+namespace detail {
+
+  /// Compile-time list 0, 1, ..., N-1 (std::index_sequence is C++14)
+  template <std::size_t... I>
+  struct IndexSequence { };
+  template <std::size_t N, std::size_t... I>
+  struct MakeIndexSequence : MakeIndexSequence<N-1, N-1, I...> { };
+  template <std::size_t... I>
+  struct MakeIndexSequence<0, I...> { typedef IndexSequence<I...> type; };
+
+  template <typename Metric, typename Tuple, std::size_t... I>
+  void ScanRangeInto(const float* x, const float* y,
+                     std::size_t begin, std::size_t end,
+                     Tuple& aggregates, IndexSequence<I...>)
+  {
+    ScanRange<Metric>(x, y, begin, end, std::get<I>(aggregates)...);
+  }
+
+  template <typename Tuple, std::size_t... I>
+  void MergeInto(Tuple& result, const Tuple& later, IndexSequence<I...>)
+  {
+    const int expand[] = {
+      0, (std::get<I>(result).Merge(std::get<I>(later)), 0)...
+    };
+    (void)expand;
+  }
+
+}  // namespace detail
+
+
+/**
+ * Multithreaded Scan(). The "aggregates" must be freshly constructed:
+ * every chunk starts from a copy of them, and the per-chunk results
+ * are merged in chunk order and assigned back to them.
+ */
+template <typename Metric = L1Metric, typename Points,
+          typename... Aggregates>
+void Scan(ThreadPool& pool, const Points& points,
+          Aggregates&... aggregates)
+{
+  typedef std::tuple<Aggregates...> Partial;
+  typedef typename detail::MakeIndexSequence<sizeof...(Aggregates)>::type
+          Indices;
+
+  const std::size_t count = points.size();
+  const std::size_t chunks = ParallelChunkCount(count);
+  if (chunks == 0)
+    return;
+  std::vector<Partial> partial(chunks, Partial(aggregates...));
+  pool.ParallelFor(chunks, [&](std::size_t chunk) {
+    const std::size_t begin = chunk * kParallelChunkSize;
+    const std::size_t end = std::min(begin + kParallelChunkSize, count);
+    detail::ScanRangeInto<Metric>(points.x_data(), points.y_data(),
+                                  begin, end, partial[chunk], Indices());
+  });
+
+  for (std::size_t chunk = 1; chunk < chunks; ++chunk)
+    detail::MergeInto(partial[0], partial[chunk], Indices());
+  std::tuple<Aggregates&...>(aggregates...) = partial[0];
+}
+
+
+/**
+ * NearestToOrigin on the work-stealing scheduler (same result and
+ * tie-breaking)
+ */
+template <typename Metric = L1Metric, typename Points>
+std::tuple<std::size_t, float> NearestToOrigin(
+                          TaskScheduler& scheduler,
+                          const Points& points
+                                              )
+{
+  typedef std::tuple<std::size_t, float> Result;
+  const std::size_t count = points.size();
+  const Result none(count, std::numeric_limits<float>::max());
+  return ParallelReduce(scheduler, 0, ParallelChunkCount(count), 1, none,
+    [&](std::size_t first_chunk, std::size_t last_chunk) -> Result {
+      const std::size_t begin = first_chunk * kParallelChunkSize;
+      const std::size_t end = std::min(last_chunk * kParallelChunkSize, count);
+      Result result = NearestToOrigin<Metric>(points.x_data() + begin,
+                                              points.y_data() + begin,
+                                              end - begin);
+      if (std::get<0>(result) == end - begin)
+        return none;
+      std::get<0>(result) += begin;
+      return result;
+    },
+    [](const Result& left, const Result& right) -> Result {
+      /// Strictly smaller only: on ties the left (lower) half wins
+      return (std::get<1>(right) < std::get<1>(left)) ? right : left;
+    });
+}
+
+
+/**
+ * CountNearOrigin on the work-stealing scheduler
+ */
+template <typename Metric = L1Metric, typename Points>
+std::size_t CountNearOrigin(TaskScheduler& scheduler,
+                            const Points& points,
+                            float threshold = 0.5f)
+{
+  const std::size_t count = points.size();
+  return ParallelReduce(scheduler, 0, ParallelChunkCount(count), 1,
+    std::size_t(0),
+    [&](std::size_t first_chunk, std::size_t last_chunk) -> std::size_t {
+      const std::size_t begin = first_chunk * kParallelChunkSize;
+      const std::size_t end = std::min(last_chunk * kParallelChunkSize, count);
+      return CountNearOrigin<Metric>(points.x_data() + begin,
+                                     points.y_data() + begin,
+                                     end - begin, threshold);
+    },
+    [](std::size_t left, std::size_t right) { return left + right; });
+}
+
+
+/**
+ * NearestKToOrigin on the work-stealing scheduler (same result and
+ * tie-breaking)
+ */
+template <typename Metric = L1Metric, typename Points>
+std::vector<Neighbor> NearestKToOrigin(TaskScheduler& scheduler,
+                                       const Points& points,
+                                       std::size_t k)
+{
+  typedef std::vector<Neighbor> Result;
+  const std::size_t count = points.size();
+  const std::size_t chunks = ParallelChunkCount(count);
+  const std::size_t run_chunks = std::max<std::size_t>(
+      1, chunks / (kNearestKRunsPerThread * scheduler.size()));
+  SharedDistanceLimit limit;
+  return ParallelReduce(scheduler, 0, chunks, run_chunks, Result(),
+    [&](std::size_t first_chunk, std::size_t last_chunk) -> Result {
+      const std::size_t begin = first_chunk * kParallelChunkSize;
+      const std::size_t end = std::min(last_chunk * kParallelChunkSize, count);
+      return detail::NearestKInRange<Metric>(points.x_data(),
+                                             points.y_data(),
+                                             begin, end, k, limit);
+    },
+    [k](const Result& left, const Result& right) -> Result {
+      return detail::MergeNearestK(left, right, k);
+    });
+}
+
+
+/**
+ * Scan() on the work-stealing scheduler; the "aggregates" must be
+ * freshly constructed (see the ThreadPool version)
+ */
+template <typename Metric = L1Metric, typename Points,
+          typename... Aggregates>
+void Scan(TaskScheduler& scheduler, const Points& points,
+          Aggregates&... aggregates)
+{
+  typedef std::tuple<Aggregates...> Partial;
+  typedef typename detail::MakeIndexSequence<sizeof...(Aggregates)>::type
+          Indices;
+
+  const std::size_t count = points.size();
+  const Partial fresh(aggregates...);
+  std::tuple<Aggregates&...>(aggregates...) =
+    ParallelReduce(scheduler, 0, ParallelChunkCount(count), 1, fresh,
+      [&](std::size_t first_chunk, std::size_t last_chunk) -> Partial {
+        const std::size_t begin = first_chunk * kParallelChunkSize;
+        const std::size_t end = std::min(last_chunk * kParallelChunkSize,
+                                         count);
+        Partial partial(fresh);
+        detail::ScanRangeInto<Metric>(points.x_data(), points.y_data(),
+                                      begin, end, partial, Indices());
+        return partial;
+      },
+      [](Partial left, const Partial& right) -> Partial {
+        detail::MergeInto(left, right, Indices());
+        return left;
+      });
+}
+
+
+#endif  // PARALLELQUERIES_H
+
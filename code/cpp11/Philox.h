@@ -0,0 +1,82 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <array>
+#include <cstdint>   // std::uint32_t, std::uint64_t
+
+
+/**
+ * Philox4x32-10, a counter-based random number generator
+ * (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", 2011)
+ *
+ * A counter-based generator has no state that moves forward. It is a
+ * keyed bijection: Generate(counter, key) scrambles a 128-bit counter
+ * with a 64-bit key into 128 random bits. Random number n of a stream
+ * is simply Generate(n, key), so any number can be computed on its
+ * own, in any order, on any thread, with no locking.
+ *
+ * The output matches the Random123 reference implementation.
+ */
+struct Philox4x32 {
+  typedef std::array<std::uint32_t, 4> Counter;
+  typedef std::array<std::uint32_t, 2> Key;
+
+  static Counter Generate(Counter counter, Key key)
+  {
+    for (int round = 0; round < 10; ++round)
+    {
+      if (round > 0)
+      {
+        key[0] += 0x9E3779B9u;
+        key[1] += 0xBB67AE85u;
+      }
+      const std::uint64_t product0 = std::uint64_t(0xD2511F53u) * counter[0];
+      const std::uint64_t product1 = std::uint64_t(0xCD9E8D57u) * counter[2];
+      counter = Counter{{
+        static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+        static_cast<std::uint32_t>(product1),
+        static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+        static_cast<std::uint32_t>(product0)
+      }};
+    }
+    return counter;
+  }
+};
+
+
+/**
+ * Map 32 random bits to a float uniformly distributed in [-1, +1).
+ * The top 24 bits give 2^24 equally spaced values, all exact floats.
+ */
+inline float UniformFromBits(std::uint32_t bits)
+{
+  return static_cast<float>(bits >> 8) * (1.f / (1u << 23)) - 1.f;
+}
+
+
+#endif  // PHILOX_H
+
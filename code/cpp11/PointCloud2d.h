@@ -0,0 +1,199 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef POINTCLOUD2D_H
+#define POINTCLOUD2D_H
+
+#include <cmath>     // std::abs
+#include <cstddef>   // std::size_t
+#include <limits>    // std::numeric_limits
+#include <tuple>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "DistanceKernels.h"
+#include "HalfFloat.h"
+
+
+/// Byte alignment of the coordinate columns (one cache line)
+constexpr std::size_t kPointCloudAlignment = 64;
+
+
+/**
+ * A set of points in 2d space, stored as a "structure of arrays"
+ *
+ * Instead of one heap object per point (std::vector<Pos2d_ptr>),
+ * all x coordinates live in one contiguous array and all y
+ * coordinates in another. Point i is (x(i), y(i)). Scanning the
+ * set then streams through two flat arrays, which is what caches,
+ * prefetchers and SIMD units like best.
+ *
+ * Coordinates are stored as T: float (PointCloud2d), or one of the
+ * 16-bit types of HalfFloat.h, which halve the memory (and memory
+ * traffic) of a scan at the cost of precision. Queries always
+ * compute in float.
+ */
+template <typename T>
+class BasicPointCloud2d {
+public:
+  static_assert(IsKernelCoordinate<T>::value,
+                "'BasicPointCloud2d' needs float or 16-bit float coordinates!");
+
+  typedef T value_type;
+  typedef std::vector<T, AlignedAllocator<T, kPointCloudAlignment>> Column;
+
+  BasicPointCloud2d() = default;
+
+  /// Create "size" points at (0, 0)
+  explicit BasicPointCloud2d(std::size_t size)
+  : x_(size, T(0.f)), y_(size, T(0.f))
+  { }
+
+  std::size_t size() const { return x_.size(); }
+  bool empty() const { return x_.empty(); }
+
+  void reserve(std::size_t capacity)
+  {
+    x_.reserve(capacity);
+    y_.reserve(capacity);
+  }
+
+  void resize(std::size_t size)
+  {
+    x_.resize(size, T(0.f));
+    y_.resize(size, T(0.f));
+  }
+
+  void clear()
+  {
+    x_.clear();
+    y_.clear();
+  }
+
+  void push_back(T x, T y)
+  {
+    x_.push_back(x);
+    y_.push_back(y);
+  }
+
+  /// Index-based access to single coordinates
+  T x(std::size_t index) const { return x_[index]; }
+  T y(std::size_t index) const { return y_[index]; }
+  T& x(std::size_t index) { return x_[index]; }
+  T& y(std::size_t index) { return y_[index]; }
+
+  /// Raw access to the (aligned, contiguous) coordinate columns
+  const T* x_data() const { return x_.data(); }
+  const T* y_data() const { return y_.data(); }
+  T* x_data() { return x_.data(); }
+  T* y_data() { return y_.data(); }
+
+private:
+  Column x_;
+  Column y_;
+};
+
+typedef BasicPointCloud2d<float> PointCloud2d;
+typedef BasicPointCloud2d<Float16> PointCloud2dF16;
+typedef BasicPointCloud2d<BFloat16> PointCloud2dBF16;
+
+
+/**
+ * L1 distance of point "index" of "points" to the origin
+ */
+template <typename T>
+float ManhattanToOrigin(const BasicPointCloud2d<T>& points, std::size_t index)
+{
+  return std::abs(float(points.x(index))) + std::abs(float(points.y(index)));
+}
+
+
+/**
+ * L1 distances of all points of "points" to the origin;
+ * "distances" must have room for points.size() values
+ */
+template <typename T>
+void ManhattanToOrigin(const BasicPointCloud2d<T>& points, float* distances)
+{
+  ManhattanToOrigin(points.x_data(), points.y_data(), points.size(),
+                    distances);
+}
+
+
+/**
+ * Distance of point "index" of "points" to the origin under "Metric"
+ * (see Metrics.h)
+ */
+template <typename Metric = L1Metric, typename T>
+float DistanceToOrigin(const BasicPointCloud2d<T>& points, std::size_t index)
+{
+  return Metric::Scalar(float(points.x(index)), float(points.y(index)));
+}
+
+
+/**
+ * Distances of all points of "points" to the origin under "Metric";
+ * "distances" must have room for points.size() values
+ */
+template <typename Metric = L1Metric, typename T>
+void DistanceToOrigin(const BasicPointCloud2d<T>& points, float* distances)
+{
+  DistanceToOrigin<Metric>(points.x_data(), points.y_data(), points.size(),
+                           distances);
+}
+
+
+/**
+ * Find the point with the smallest distance to the origin under
+ * "Metric" (L1 by default).
+ *
+ * Returns the index of that point and its distance. If several points
+ * are equally near, the lowest index wins. For an empty set the index
+ * is points.size() and the distance is std::numeric_limits<float>::max().
+ */
+template <typename Metric = L1Metric, typename T>
+std::tuple<std::size_t, float> NearestToOrigin(
+                          const BasicPointCloud2d<T>& points
+                                              )
+{
+  return NearestToOrigin<Metric>(points.x_data(), points.y_data(),
+                                 points.size());
+}
+
+
+/**
+ * Count the points whose distance to the origin under "Metric" (L1 by
+ * default) is less than "threshold"
+ */
+template <typename Metric = L1Metric, typename T>
+std::size_t CountNearOrigin(const BasicPointCloud2d<T>& points,
+                            float threshold = 0.5f)
+{
+  return CountNearOrigin<Metric>(points.x_data(), points.y_data(),
+                                 points.size(), threshold);
+}
+
+
+#endif  // POINTCLOUD2D_H
+
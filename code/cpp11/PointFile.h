@@ -0,0 +1,344 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef POINTFILE_H
+#define POINTFILE_H
+
+#include <cerrno>    // errno
+#include <cmath>     // std::abs
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint8_t, std::uint32_t, std::uint64_t
+#include <cstdio>    // std::FILE, std::fopen, std::fwrite, ...
+#include <cstring>   // std::memcmp, std::memcpy, std::strerror
+#include <limits>    // std::numeric_limits
+#include <stdexcept> // std::runtime_error
+#include <string>
+#include <tuple>
+
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, munmap, madvise
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close
+
+#include "DistanceKernels.h"
+#include "PointCloud2d.h"
+#include "ScanEngine.h"
+
+
+/**
+ * Binary point file format, version 1 (all numbers in the native byte
+ * order of the writer, recorded in byte_order; files from the other
+ * byte order are rejected)
+ *
+ *   offset 0:         PointFileHeader (64 bytes)
+ *   offset x_offset:  count float32 x coordinates
+ *   offset y_offset:  count float32 y coordinates
+ *
+ * Both column offsets are multiples of kPointFileAlignment, with zero
+ * padding in between, so a memory-mapped file can be used in place:
+ * the columns have the same layout and alignment as the columns of a
+ * PointCloud2d. The checksum covers the two columns (not the padding)
+ * and is only checked on request, since checking means reading the
+ * whole file.
+ */
+constexpr std::uint32_t kPointFileVersion = 1;
+constexpr std::size_t kPointFileAlignment = 64;
+
+struct PointFileHeader {
+  char magic[8];               ///< "PCLOUD2D"
+  std::uint32_t version;       ///< kPointFileVersion
+  std::uint32_t byte_order;    ///< kByteOrderMark as written by the writer
+  std::uint64_t count;         ///< Number of points
+  std::uint64_t x_offset;      ///< Byte offset of the x column
+  std::uint64_t y_offset;      ///< Byte offset of the y column
+  std::uint64_t checksum;      ///< PointFileChecksum of x, then y column
+  std::uint8_t reserved[16];   ///< Zero
+
+  static constexpr std::uint32_t kByteOrderMark = 0x01020304;
+};
+
+static_assert(sizeof(PointFileHeader) == 64,
+              "'PointFileHeader' must be exactly 64 bytes!");
+
+
+/**
+ * Fletcher-style 64-bit checksum of "count" 32-bit words, continued
+ * from "state" (start with PointFileChecksumState{0, 0}). Unlike a
+ * plain sum it changes when words are swapped or moved.
+ */
+struct PointFileChecksumState {
+  std::uint64_t sum;
+  std::uint64_t sum_of_sums;
+
+  void Update(const float* words, std::size_t count)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      std::uint32_t word;
+      std::memcpy(&word, words + i, sizeof(word));
+      sum += word;
+      sum_of_sums += sum;
+    }
+  }
+
+  std::uint64_t Final() const
+  {
+    return sum + sum_of_sums * 0x9E3779B97F4A7C15ull;
+  }
+};
+
+
+namespace detail {
+
+  inline std::uint64_t AlignFileOffset(std::uint64_t offset)
+  {
+    return (offset + kPointFileAlignment - 1) / kPointFileAlignment
+           * kPointFileAlignment;
+  }
+
+  inline std::runtime_error PointFileError(const std::string& path,
+                                           const std::string& what)
+  {
+    return std::runtime_error("Point file '" + path + "': " + what);
+  }
+
+}  // namespace detail
+
+
+/**
+ * Write "points" to the file "path" in the format above, replacing
+ * the file if it exists. Throws std::runtime_error on I/O errors.
+ */
+inline void WritePointFile(const std::string& path, const PointCloud2d& points)
+{
+  const std::uint64_t count = points.size();
+  PointFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "PCLOUD2D", sizeof(header.magic));
+  header.version = kPointFileVersion;
+  header.byte_order = PointFileHeader::kByteOrderMark;
+  header.count = count;
+  header.x_offset = detail::AlignFileOffset(sizeof(PointFileHeader));
+  header.y_offset = detail::AlignFileOffset(header.x_offset +
+                                            count * sizeof(float));
+  /// The columns of an empty cloud may be null pointers, which neither
+  /// the checksum nor std::fwrite must see; the file is then just the
+  /// header
+  PointFileChecksumState checksum{0, 0};
+  if (count > 0)
+  {
+    checksum.Update(points.x_data(), count);
+    checksum.Update(points.y_data(), count);
+  }
+  header.checksum = checksum.Final();
+
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    throw detail::PointFileError(path, std::strerror(errno));
+  static const char kPadding[kPointFileAlignment] = {};
+  const std::size_t x_padding = header.x_offset - sizeof(header);
+  const std::size_t y_padding = header.y_offset - header.x_offset
+                                - count * sizeof(float);
+  const bool written =
+    std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+    (count == 0 ||
+     (std::fwrite(kPadding, 1, x_padding, file) == x_padding &&
+      std::fwrite(points.x_data(), sizeof(float), count, file) == count &&
+      std::fwrite(kPadding, 1, y_padding, file) == y_padding &&
+      std::fwrite(points.y_data(), sizeof(float), count, file) == count));
+  if (std::fclose(file) != 0 || !written)
+    throw detail::PointFileError(path, "write failed");
+}
+
+
+/**
+ * A point file, memory-mapped read-only
+ *
+ *   MappedPointCloud2d points("points.bin");
+ *   NearestToOrigin(points);
+ *
+ * Opening only maps the file and checks the header, so it takes the
+ * same (short) time for any file size: the coordinates are used in
+ * place, and the operating system pages them in when a query first
+ * reads them. The class has the read-only interface of PointCloud2d
+ * (size(), x(i), x_data(), ...), and all queries work on it without
+ * copying. Throws std::runtime_error if the file cannot be mapped or
+ * is not a valid point file.
+ */
+class MappedPointCloud2d {
+public:
+  explicit MappedPointCloud2d(const std::string& path)
+  : path_(path), data_(nullptr), bytes_(0), header_()
+  {
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+      throw detail::PointFileError(path, std::strerror(errno));
+    struct stat status;
+    if (::fstat(file, &status) != 0)
+    {
+      const int error = errno;
+      ::close(file);
+      throw detail::PointFileError(path, std::strerror(error));
+    }
+    bytes_ = static_cast<std::size_t>(status.st_size);
+    if (bytes_ < sizeof(PointFileHeader))
+    {
+      ::close(file);
+      throw detail::PointFileError(path, "too short for a header");
+    }
+    void* data = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, file, 0);
+    /// The mapping stays valid after the descriptor is closed
+    ::close(file);
+    if (data == MAP_FAILED)
+      throw detail::PointFileError(path, std::strerror(errno));
+    data_ = static_cast<const char*>(data);
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    const char* problem = CheckHeader();
+    if (problem)
+    {
+      ::munmap(const_cast<char*>(data_), bytes_);
+      throw detail::PointFileError(path, problem);
+    }
+    /// Queries stream through the columns front to back
+    ::madvise(const_cast<char*>(data_), bytes_, MADV_SEQUENTIAL);
+  }
+
+  ~MappedPointCloud2d()
+  {
+    ::munmap(const_cast<char*>(data_), bytes_);
+  }
+
+  MappedPointCloud2d(const MappedPointCloud2d&) = delete;
+  MappedPointCloud2d& operator=(const MappedPointCloud2d&) = delete;
+
+  std::size_t size() const { return header_.count; }
+  bool empty() const { return header_.count == 0; }
+
+  float x(std::size_t index) const { return x_data()[index]; }
+  float y(std::size_t index) const { return y_data()[index]; }
+
+  const float* x_data() const
+  {
+    return reinterpret_cast<const float*>(data_ + header_.x_offset);
+  }
+  const float* y_data() const
+  {
+    return reinterpret_cast<const float*>(data_ + header_.y_offset);
+  }
+
+  const std::string& path() const { return path_; }
+  const PointFileHeader& header() const { return header_; }
+
+  /// Read both columns and compare their checksum with the header's
+  bool VerifyChecksum() const
+  {
+    PointFileChecksumState checksum{0, 0};
+    checksum.Update(x_data(), size());
+    checksum.Update(y_data(), size());
+    return checksum.Final() == header_.checksum;
+  }
+
+private:
+  /// nullptr if the header is valid for a file of bytes_ bytes
+  const char* CheckHeader() const
+  {
+    if (std::memcmp(header_.magic, "PCLOUD2D", sizeof(header_.magic)) != 0)
+      return "not a point file";
+    if (header_.byte_order != PointFileHeader::kByteOrderMark)
+      return "wrong byte order";
+    if (header_.version != kPointFileVersion)
+      return "unsupported version";
+    const std::uint64_t column_bytes = header_.count * sizeof(float);
+    if (header_.count > std::numeric_limits<std::uint64_t>::max() / 8 ||
+        header_.x_offset > bytes_ ||
+        header_.x_offset < sizeof(PointFileHeader) ||
+        header_.x_offset % kPointFileAlignment != 0 ||
+        header_.y_offset % kPointFileAlignment != 0 ||
+        header_.y_offset < header_.x_offset + column_bytes ||
+        header_.y_offset > bytes_ ||
+        bytes_ - header_.y_offset < column_bytes)
+      return "corrupt header or truncated file";
+    return nullptr;
+  }
+
+  std::string path_;
+  const char* data_;
+  std::size_t bytes_;
+  PointFileHeader header_;
+};
+
+
+/**
+ * The point queries of PointCloud2d.h and ScanEngine.h for a mapped
+ * file (the multithreaded versions in ParallelQueries.h take any
+ * point set)
+ */
+inline float ManhattanToOrigin(const MappedPointCloud2d& points,
+                               std::size_t index)
+{
+  return std::abs(points.x(index)) + std::abs(points.y(index));
+}
+
+inline void ManhattanToOrigin(const MappedPointCloud2d& points,
+                              float* distances)
+{
+  ManhattanToOrigin(points.x_data(), points.y_data(), points.size(),
+                    distances);
+}
+
+template <typename Metric = L1Metric>
+void DistanceToOrigin(const MappedPointCloud2d& points, float* distances)
+{
+  DistanceToOrigin<Metric>(points.x_data(), points.y_data(), points.size(),
+                           distances);
+}
+
+template <typename Metric = L1Metric>
+std::tuple<std::size_t, float> NearestToOrigin(
+                          const MappedPointCloud2d& points
+                                              )
+{
+  return NearestToOrigin<Metric>(points.x_data(), points.y_data(),
+                                 points.size());
+}
+
+template <typename Metric = L1Metric>
+std::size_t CountNearOrigin(const MappedPointCloud2d& points,
+                            float threshold = 0.5f)
+{
+  return CountNearOrigin<Metric>(points.x_data(), points.y_data(),
+                                 points.size(), threshold);
+}
+
+template <typename Metric = L1Metric, typename... Aggregates>
+void Scan(const MappedPointCloud2d& points, Aggregates&... aggregates)
+{
+  Scan<Metric>(points.x_data(), points.y_data(), points.size(),
+               aggregates...);
+}
+
+
+#endif  // POINTFILE_H
+
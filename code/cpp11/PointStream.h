@@ -0,0 +1,200 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef POINTSTREAM_H
+#define POINTSTREAM_H
+
+#include <cerrno>    // errno
+#include <cstddef>   // std::size_t
+#include <cstdio>    // std::FILE, std::fread, std::ferror
+#include <cstdlib>   // std::strtof
+#include <cstring>   // std::memmove, std::strerror
+#include <stdexcept> // std::runtime_error
+#include <string>
+#include <vector>
+
+#include "PointCloud2d.h"
+#include "ScanEngine.h"
+
+
+/// Points per chunk of a streamed scan (512 KB of coordinates)
+constexpr std::size_t kStreamChunkSize = std::size_t(1) << 16;
+
+static_assert(kStreamChunkSize % kScanBlockSize == 0,
+              "Stream chunks must consist of whole scan blocks!");
+
+/// Bytes per fread() from the input of a PointReader
+constexpr std::size_t kStreamReadSize = std::size_t(1) << 16;
+
+
+/**
+ * Reads points as text, "x y" per line, from a FILE (e.g. stdin)
+ *
+ * Any whitespace separates numbers, so "x y x y ..." on one line
+ * works too. The input is read kStreamReadSize bytes at a time into
+ * a fixed buffer, so the memory use does not depend on the input
+ * size. Read() throws std::runtime_error on read errors, malformed
+ * numbers and a dangling x coordinate at the end.
+ */
+class PointReader {
+public:
+  explicit PointReader(std::FILE* file)
+  : file_(file), buffer_(kStreamReadSize + 1), begin_(0), end_(0),
+    eof_(false), points_(0)
+  { }
+
+  /**
+   * Read up to "capacity" points into x[0 ..], y[0 ..]; returns the
+   * number of points read, which is 0 only at the end of the input
+   */
+  std::size_t Read(float* x, float* y, std::size_t capacity)
+  {
+    std::size_t count = 0;
+    while (count < capacity && NextNumber(x[count]))
+    {
+      if (!NextNumber(y[count]))
+        throw Error("x coordinate without y coordinate");
+      ++count;
+      ++points_;
+    }
+    return count;
+  }
+
+  /// Number of points read so far
+  std::size_t points() const { return points_; }
+
+private:
+  static bool IsSpace(char c)
+  {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' ||
+           c == '\v' || c == '\f';
+  }
+
+  /// Move the unparsed bytes to the front and append fresh input
+  void Refill()
+  {
+    std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+    end_ += std::fread(buffer_.data() + end_, 1, kStreamReadSize - end_,
+                       file_);
+    if (end_ < kStreamReadSize)
+    {
+      if (std::ferror(file_))
+        throw Error(std::strerror(errno));
+      eof_ = std::feof(file_) != 0;
+    }
+  }
+
+  /// Parse the next number; false at the end of the input
+  bool NextNumber(float& value)
+  {
+    for (;;)
+    {
+      while (begin_ < end_ && IsSpace(buffer_[begin_]))
+        ++begin_;
+      if (begin_ == end_)
+      {
+        if (eof_)
+          return false;
+        Refill();
+        continue;
+      }
+      std::size_t token_end = begin_;
+      while (token_end < end_ && !IsSpace(buffer_[token_end]))
+        ++token_end;
+      /// The token may continue in the next read
+      if (token_end == end_ && !eof_)
+      {
+        if (begin_ == 0 && end_ == kStreamReadSize)
+          throw Error("number too long");
+        Refill();
+        continue;
+      }
+
+      /// The buffer has one spare byte, so there is always room for
+      /// the terminator that strtof() needs
+      const char saved = buffer_[token_end];
+      buffer_[token_end] = '\0';
+      char* parse_end;
+      value = std::strtof(buffer_.data() + begin_, &parse_end);
+      buffer_[token_end] = saved;
+      if (parse_end != buffer_.data() + token_end)
+        throw Error("'" + std::string(buffer_.data() + begin_,
+                                      buffer_.data() + token_end)
+                    + "' is not a number");
+      begin_ = token_end;
+      return true;
+    }
+  }
+
+  std::runtime_error Error(const std::string& what) const
+  {
+    return std::runtime_error("Point " + std::to_string(points_ + 1) +
+                              " of the input: " + what);
+  }
+
+  std::FILE* file_;
+  std::vector<char> buffer_;
+  /// Unparsed bytes are buffer_[begin_, end_)
+  std::size_t begin_;
+  std::size_t end_;
+  bool eof_;
+  std::size_t points_;
+};
+
+
+/**
+ * Scan() over points read from "file" as text (see PointReader),
+ * without ever holding more than kStreamChunkSize points
+ *
+ * The aggregates see the same blocks with the same indices as if all
+ * points had been loaded into a PointCloud2d first, so the results
+ * are identical; use aggregates like NearestPoint, which keep what
+ * they need, since the points themselves are gone afterwards. The
+ * memory use is the same for inputs of any length. Returns the number
+ * of points scanned. As for Scan(), the distances are those of
+ * "Metric" (L1 by default).
+ */
+template <typename Metric = L1Metric, typename... Aggregates>
+std::size_t ScanStream(std::FILE* file, Aggregates&... aggregates)
+{
+  PointReader reader(file);
+  PointCloud2d chunk(kStreamChunkSize);
+  std::size_t scanned = 0;
+  for (;;)
+  {
+    const std::size_t count = reader.Read(chunk.x_data(), chunk.y_data(),
+                                          kStreamChunkSize);
+    if (count == 0)
+      return scanned;
+    detail::ScanBlocks<Metric>(chunk.x_data(), chunk.y_data(), count,
+                               scanned, aggregates...);
+    scanned += count;
+  }
+}
+
+
+#endif  // POINTSTREAM_H
+
@@ -0,0 +1,227 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef POINTWRITER_H
+#define POINTWRITER_H
+
+#include <algorithm> // std::min
+#include <cerrno>    // errno, EINTR
+#include <cstddef>   // std::size_t
+#include <cstring>   // std::strerror
+#include <stdexcept> // std::runtime_error
+#include <string>
+#include <vector>
+
+#include <limits.h>    // IOV_MAX
+#include <sys/uio.h>   // writev, struct iovec
+#include <unistd.h>    // write
+
+#include "FloatFormat.h"
+#include "ParallelQueries.h"
+#include "ScanEngine.h"
+#include "TaskScheduler.h"
+
+
+/**
+ * Fast text output of points, "x y" per line
+ *
+ * The coordinates are formatted with FormatFloat() (shortest
+ * round-trip, see FloatFormat.h) straight into a large byte buffer,
+ * which goes to the file descriptor with a single write() when full.
+ * Reading the text back (e.g. with PointReader, see PointStream.h)
+ * gives exactly the same floats.
+ */
+
+
+/// Bytes buffered by a PointTextWriter before it writes
+constexpr std::size_t kPointWriterBufferSize = std::size_t(1) << 20;
+
+/// Longest line: two numbers, a space and a newline
+constexpr std::size_t kMaxPointLineChars = 2 * kMaxFloatChars + 2;
+
+
+namespace detail {
+
+  /// Append "x y\n" to "out"; returns the new end
+  inline char* FormatPointLine(float x, float y, char* out)
+  {
+    out = FormatFloat(x, out);
+    *out++ = ' ';
+    out = FormatFloat(y, out);
+    *out++ = '\n';
+    return out;
+  }
+
+  /**
+   * Write all "count" buffers to "fd", with as few writev() calls as
+   * the kernel allows (partial writes are continued); throws
+   * std::runtime_error on errors. Modifies "buffers".
+   */
+  inline void WriteAll(int fd, struct iovec* buffers, std::size_t count)
+  {
+    while (count > 0)
+    {
+      const int batch = static_cast<int>(std::min<std::size_t>(count, IOV_MAX));
+      const ssize_t written = ::writev(fd, buffers, batch);
+      if (written < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        throw std::runtime_error(std::string("Writing points: ")
+                                 + std::strerror(errno));
+      }
+      /// Skip what was written: whole buffers, then part of one
+      std::size_t rest = static_cast<std::size_t>(written);
+      while (count > 0 && rest >= buffers->iov_len)
+      {
+        rest -= buffers->iov_len;
+        ++buffers;
+        --count;
+      }
+      if (count > 0)
+      {
+        buffers->iov_base = static_cast<char*>(buffers->iov_base) + rest;
+        buffers->iov_len -= rest;
+      }
+    }
+  }
+
+}  // namespace detail
+
+
+/**
+ * Buffered writer for one point at a time
+ *
+ *   PointTextWriter writer(STDOUT_FILENO);
+ *   for (...)
+ *     writer.Write(x, y);
+ *   writer.Flush();
+ *
+ * It also works as a Scan() aggregate (Consume() only), which writes
+ * the points of every block, e.g. to copy a stream in ScanStream().
+ * Call Flush() at the end to see write errors; the destructor flushes
+ * as well, but cannot report errors.
+ */
+class PointTextWriter {
+public:
+  explicit PointTextWriter(int fd,
+                           std::size_t buffer_size = kPointWriterBufferSize)
+  : fd_(fd), buffer_(std::max(buffer_size, kMaxPointLineChars)), size_(0)
+  { }
+
+  ~PointTextWriter()
+  {
+    try
+    {
+      Flush();
+    }
+    catch (const std::runtime_error&)
+    { }
+  }
+
+  PointTextWriter(const PointTextWriter&) = delete;
+  PointTextWriter& operator=(const PointTextWriter&) = delete;
+
+  void Write(float x, float y)
+  {
+    if (buffer_.size() - size_ < kMaxPointLineChars)
+      Flush();
+    size_ = detail::FormatPointLine(x, y, buffer_.data() + size_)
+            - buffer_.data();
+  }
+
+  /// Write all points of "points" (anything with size(), x(i), y(i))
+  template <typename Points>
+  void Write(const Points& points)
+  {
+    for (std::size_t i = 0; i < points.size(); ++i)
+      Write(points.x(i), points.y(i));
+  }
+
+  void Consume(const ScanBlock& block)
+  {
+    for (std::size_t i = 0; i < block.count; ++i)
+      Write(block.x[i], block.y[i]);
+  }
+
+  void Flush()
+  {
+    if (size_ == 0)
+      return;
+    struct iovec buffer = {buffer_.data(), size_};
+    size_ = 0;
+    detail::WriteAll(fd_, &buffer, 1);
+  }
+
+private:
+  int fd_;
+  std::vector<char> buffer_;
+  std::size_t size_;
+};
+
+
+/**
+ * Write all points of "points" to "fd", formatted in parallel
+ *
+ * Every chunk of kParallelChunkSize points is formatted into a buffer
+ * of its own, by whichever thread takes it; a group of chunks (a few
+ * per thread, so that memory use stays bounded) is then written with
+ * a single writev() in chunk order. The output is the same as from a
+ * PointTextWriter.
+ */
+template <typename Points>
+void WritePointsText(TaskScheduler& scheduler, int fd, const Points& points)
+{
+  const std::size_t count = points.size();
+  const std::size_t chunks = ParallelChunkCount(count);
+  const std::size_t group_size = 4 * scheduler.size();
+  std::vector<std::vector<char>> text(std::min(group_size, chunks));
+  std::vector<struct iovec> buffers(text.size());
+
+  for (std::size_t group = 0; group < chunks; group += group_size)
+  {
+    const std::size_t group_end = std::min(group + group_size, chunks);
+    ParallelForRange(scheduler, group, group_end, 1,
+      [&](std::size_t first_chunk, std::size_t last_chunk) {
+        for (std::size_t chunk = first_chunk; chunk < last_chunk; ++chunk)
+        {
+          const std::size_t begin = chunk * kParallelChunkSize;
+          const std::size_t end = std::min(begin + kParallelChunkSize, count);
+          std::vector<char>& out = text[chunk - group];
+          out.resize((end - begin) * kMaxPointLineChars);
+          char* position = out.data();
+          for (std::size_t i = begin; i < end; ++i)
+            position = detail::FormatPointLine(points.x(i), points.y(i),
+                                               position);
+          buffers[chunk - group].iov_base = out.data();
+          buffers[chunk - group].iov_len = position - out.data();
+        }
+      });
+    detail::WriteAll(fd, buffers.data(), group_end - group);
+  }
+}
+
+
+#endif  // POINTWRITER_H
+
@@ -0,0 +1,622 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QUADTREE_H
+#define QUADTREE_H
+
+#include <cmath>     // std::abs, std::isfinite
+#include <cstddef>   // std::size_t
+#include <limits>    // std::numeric_limits
+#include <stdexcept> // std::runtime_error
+#include <vector>
+
+#include "DistanceKernels.h"
+#include "NearestK.h"
+
+
+/**
+ * A quadtree over a changing point set, for L1 nearest-point and
+ * radius queries without rebuilding or rescanning
+ *
+ * Insert() gives every point an id (reused after Erase()); Move()
+ * changes a point's position and keeps its id. Each update descends
+ * from the root to one leaf, O(depth), adjusting the point counts of
+ * the nodes on the way:
+ *
+ * - A leaf holds its points in fixed-size buckets of kBucketSize
+ *   (coordinates stored as arrays, scanned with the SIMD kernels). A
+ *   leaf with more points splits into four quadrants, unless it is
+ *   kMaxDepth deep (only for piles of (nearly) equal points), where it
+ *   chains more buckets instead.
+ * - A subtree left with kMergeSize points or fewer after an erase
+ *   collapses back into one leaf. The gap between the two sizes keeps
+ *   a point moving to and fro from splitting and merging each time.
+ * - The root grows (doubling away from the point) when a point lands
+ *   outside it, so the initial bounds are only a hint.
+ *
+ * Nodes come four siblings at a time, and buckets one at a time, from
+ * pools with free lists; updates reuse freed nodes and buckets, and
+ * allocate only while the tree is larger than it has ever been.
+ *
+ * Queries prune with the L1 distance from the query point to a node's
+ * rectangle (nearest and farthest), computed in float like the point
+ * distances themselves, so the results match the kernels over the same
+ * points exactly: CountWithin() is CountNearPoint(), Nearest() is the
+ * NearestToOrigin rule (lowest id on ties, only distances below
+ * std::numeric_limits<float>::max()). A subtree entirely within the
+ * radius adds its count without being visited.
+ *
+ * Points with a non-finite coordinate get an id (and count in size())
+ * but stay out of the tree: they are never near anything. Not thread
+ * safe; queries may run concurrently only with each other.
+ */
+class Quadtree2d {
+public:
+  /// Points per leaf bucket; a leaf with more points splits
+  static constexpr std::size_t kBucketSize = 128;
+  /// Subtrees with at most this many points collapse into a leaf
+  static constexpr std::size_t kMergeSize = 64;
+  /// Leaves at this depth never split
+  static constexpr unsigned kMaxDepth = 40;
+  /// The id of no point
+  static constexpr std::size_t kNoId = std::numeric_limits<std::size_t>::max();
+
+  /// A tree whose root initially covers [-1, 1) x [-1, 1)
+  Quadtree2d()
+  : Quadtree2d(-1.f, -1.f, 1.f, 1.f)
+  { }
+
+  /// A tree whose root initially covers [min_x, max_x) x [min_y, max_y)
+  Quadtree2d(float min_x, float min_y, float max_x, float max_y)
+  : size_{0}
+  {
+    if (!(std::isfinite(min_x) && std::isfinite(max_x) && min_x < max_x &&
+          std::isfinite(min_y) && std::isfinite(max_y) && min_y < max_y))
+      throw std::runtime_error("Quadtree2d: invalid bounds");
+    nodes_.push_back(Node{min_x, min_y, max_x, max_y, 0, kNone, kNone});
+  }
+
+  /// Build over "points" (anything with size(), x_data() and y_data());
+  /// point i gets id i
+  template <typename Points>
+  explicit Quadtree2d(const Points& points)
+  : Quadtree2d()
+  {
+    x_.reserve(points.size());
+    y_.reserve(points.size());
+    live_.reserve(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+      Insert(points.x_data()[i], points.y_data()[i]);
+  }
+
+  /// Number of points (ids in use)
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  /// Whether "id" is in use
+  bool contains(std::size_t id) const
+  {
+    return id < live_.size() && live_[id];
+  }
+
+  /// Position of the point "id" (which must be in use)
+  float x(std::size_t id) const { return x_[id]; }
+  float y(std::size_t id) const { return y_[id]; }
+
+  /// Add the point (x, y); returns its id
+  std::size_t Insert(float x, float y)
+  {
+    std::size_t id;
+    if (free_ids_.empty())
+    {
+      id = live_.size();
+      x_.push_back(x);
+      y_.push_back(y);
+      live_.push_back(1);
+    }
+    else
+    {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+      x_[id] = x;
+      y_[id] = y;
+      live_[id] = 1;
+    }
+    ++size_;
+    if (std::isfinite(x) && std::isfinite(y))
+    {
+      Grow(x, y);
+      Place(0, 0, x, y, id);
+    }
+    return id;
+  }
+
+  /// Remove the point "id"; false if "id" is not in use
+  bool Erase(std::size_t id)
+  {
+    if (!contains(id))
+      return false;
+    Remove(id);
+    live_[id] = 0;
+    free_ids_.push_back(id);
+    --size_;
+    return true;
+  }
+
+  /// Move the point "id" to (x, y); false if "id" is not in use
+  bool Move(std::size_t id, float x, float y)
+  {
+    if (!contains(id))
+      return false;
+    Remove(id);
+    x_[id] = x;
+    y_[id] = y;
+    if (std::isfinite(x) && std::isfinite(y))
+    {
+      Grow(x, y);
+      Place(0, 0, x, y, id);
+    }
+    return true;
+  }
+
+  /**
+   * The point nearest to (qx, qy) and its L1 distance ("index" is the
+   * id); lowest id on ties. Without such a point the id is kNoId and
+   * the distance is std::numeric_limits<float>::max().
+   */
+  Neighbor Nearest(float qx, float qy) const
+  {
+    Neighbor best{kNoId, std::numeric_limits<float>::max()};
+    if (std::isfinite(qx) && std::isfinite(qy))
+      Search(0, qx, qy, best);
+    return best;
+  }
+
+  /// Number of points with an L1 distance to (qx, qy) less than "radius"
+  std::size_t CountWithin(float qx, float qy, float radius) const
+  {
+    if (!(radius > 0.f) || !std::isfinite(qx) || !std::isfinite(qy))
+      return 0;
+    return Count(0, qx, qy, radius);
+  }
+
+private:
+  static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+  /// A rectangle [min_x, max_x) x [min_y, max_y) of the plane
+  struct Node {
+    float min_x;
+    float min_y;
+    float max_x;
+    float max_y;
+    /// Points in the subtree
+    std::size_t count;
+    /// First of the four children (kNone for a leaf); children are
+    /// ordered low x low y, high x low y, low x high y, high x high y
+    std::size_t child;
+    /// A leaf's first bucket (kNone if it has none)
+    std::size_t bucket;
+  };
+
+  /// Part of a leaf's points; a leaf's point i is in its
+  /// (i / kBucketSize)-th bucket
+  struct Bucket {
+    float x[kBucketSize];
+    float y[kBucketSize];
+    std::size_t id[kBucketSize];
+    /// Next bucket of the leaf, or (while free) of the free list
+    std::size_t next;
+  };
+
+  /// Index of the child of "node" (internal) which contains (x, y)
+  std::size_t ChildAt(std::size_t node, float x, float y) const
+  {
+    const std::size_t child = nodes_[node].child;
+    const Node& low = nodes_[child];
+    return child + (x >= low.max_x ? 1 : 0) + (y >= low.max_y ? 2 : 0);
+  }
+
+  /// Make the root cover (x, y), adding roots above it as needed
+  void Grow(float x, float y)
+  {
+    for (;;)
+    {
+      const Node root = nodes_[0];
+      const bool left = (x < root.min_x);
+      const bool right = (x >= root.max_x);
+      const bool below = (y < root.min_y);
+      const bool above = (y >= root.max_y);
+      if (!left && !right && !below && !above)
+        return;
+      const float width = root.max_x - root.min_x;
+      const float height = root.max_y - root.min_y;
+      /// Away from (x, y) from the old root's corner, which becomes
+      /// the new root's split point
+      const float split_x = left ? root.min_x : root.max_x;
+      const float split_y = below ? root.min_y : root.max_y;
+      const float min_x = left ? root.min_x - width : root.min_x;
+      const float max_x = left ? root.max_x : root.max_x + width;
+      const float min_y = below ? root.min_y - height : root.min_y;
+      const float max_y = below ? root.max_y : root.max_y + height;
+
+      const std::size_t child = AllocateChildren(min_x, min_y, max_x, max_y,
+                                                 split_x, split_y);
+      const std::size_t old_root = child + (left ? 1 : 0) + (below ? 2 : 0);
+      nodes_[old_root] = root;
+      nodes_[0] = Node{min_x, min_y, max_x, max_y, root.count, child, kNone};
+    }
+  }
+
+  /**
+   * Four empty leaves which split [min_x, max_x) x [min_y, max_y) at
+   * (split_x, split_y); returns the first
+   */
+  std::size_t AllocateChildren(float min_x, float min_y,
+                               float max_x, float max_y,
+                               float split_x, float split_y)
+  {
+    std::size_t child;
+    if (free_children_.empty())
+    {
+      child = nodes_.size();
+      nodes_.resize(child + 4);
+    }
+    else
+    {
+      child = free_children_.back();
+      free_children_.pop_back();
+    }
+    nodes_[child]   = Node{min_x, min_y, split_x, split_y, 0, kNone, kNone};
+    nodes_[child+1] = Node{split_x, min_y, max_x, split_y, 0, kNone, kNone};
+    nodes_[child+2] = Node{min_x, split_y, split_x, max_y, 0, kNone, kNone};
+    nodes_[child+3] = Node{split_x, split_y, max_x, max_y, 0, kNone, kNone};
+    return child;
+  }
+
+  std::size_t AllocateBucket()
+  {
+    std::size_t bucket;
+    if (free_bucket_ == kNone)
+    {
+      bucket = buckets_.size();
+      buckets_.emplace_back();
+    }
+    else
+    {
+      bucket = free_bucket_;
+      free_bucket_ = buckets_[bucket].next;
+    }
+    buckets_[bucket].next = kNone;
+    return bucket;
+  }
+
+  void FreeBucket(std::size_t bucket)
+  {
+    buckets_[bucket].next = free_bucket_;
+    free_bucket_ = bucket;
+  }
+
+  /// Add the point "id" at (x, y) to the subtree "node" at "depth"
+  void Place(std::size_t node, unsigned depth, float x, float y,
+             std::size_t id)
+  {
+    while (nodes_[node].child != kNone)
+    {
+      ++nodes_[node].count;
+      node = ChildAt(node, x, y);
+      ++depth;
+    }
+
+    /// Append to the leaf; a new bucket if the last one is full
+    const std::size_t position = nodes_[node].count++;
+    std::size_t bucket = nodes_[node].bucket;
+    if (position == 0)
+      bucket = nodes_[node].bucket = AllocateBucket();
+    else
+    {
+      for (std::size_t skip = (position - 1) / kBucketSize; skip > 0; --skip)
+        bucket = buckets_[bucket].next;
+      if (position % kBucketSize == 0)
+      {
+        const std::size_t next = AllocateBucket();
+        buckets_[bucket].next = next;
+        bucket = next;
+      }
+    }
+    const std::size_t slot = position % kBucketSize;
+    buckets_[bucket].x[slot] = x;
+    buckets_[bucket].y[slot] = y;
+    buckets_[bucket].id[slot] = id;
+
+    if (position == kBucketSize && depth < kMaxDepth)
+      Split(node, depth);
+  }
+
+  /// Turn the (overfull) leaf "node" at "depth" into four quadrants
+  void Split(std::size_t node, unsigned depth)
+  {
+    const std::size_t count = nodes_[node].count;
+    std::vector<Bucket> points;
+    for (std::size_t bucket = nodes_[node].bucket; bucket != kNone; )
+    {
+      points.push_back(buckets_[bucket]);
+      const std::size_t next = buckets_[bucket].next;
+      FreeBucket(bucket);
+      bucket = next;
+    }
+
+    const Node leaf = nodes_[node];
+    const float split_x = static_cast<float>(
+                            0.5 * (double(leaf.min_x) + leaf.max_x));
+    const float split_y = static_cast<float>(
+                            0.5 * (double(leaf.min_y) + leaf.max_y));
+    const std::size_t child = AllocateChildren(leaf.min_x, leaf.min_y,
+                                               leaf.max_x, leaf.max_y,
+                                               split_x, split_y);
+    nodes_[node].count = 0;
+    nodes_[node].child = child;
+    nodes_[node].bucket = kNone;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const Bucket& bucket = points[i / kBucketSize];
+      const std::size_t slot = i % kBucketSize;
+      Place(node, depth, bucket.x[slot], bucket.y[slot], bucket.id[slot]);
+    }
+  }
+
+  /// Take the point "id" out of the tree (if it is in it)
+  void Remove(std::size_t id)
+  {
+    const float x = x_[id];
+    const float y = y_[id];
+    if (!std::isfinite(x) || !std::isfinite(y))
+      return;
+    std::size_t node = 0;
+    while (nodes_[node].child != kNone)
+    {
+      if (--nodes_[node].count <= kMergeSize)
+      {
+        Collapse(node, id);
+        return;
+      }
+      node = ChildAt(node, x, y);
+    }
+    RemoveFromLeaf(node, id);
+  }
+
+  /// Remove "id" from the leaf "node"; its last point fills the gap
+  void RemoveFromLeaf(std::size_t node, std::size_t id)
+  {
+    const std::size_t last = --nodes_[node].count;
+    std::size_t bucket = nodes_[node].bucket;
+    std::size_t previous = kNone;
+    std::size_t found_bucket = kNone;
+    std::size_t found_slot = 0;
+    for (std::size_t position = 0; ; ++position)
+    {
+      const std::size_t slot = position % kBucketSize;
+      if (slot == 0 && position > 0)
+      {
+        previous = bucket;
+        bucket = buckets_[bucket].next;
+      }
+      if (buckets_[bucket].id[slot] == id)
+      {
+        found_bucket = bucket;
+        found_slot = slot;
+      }
+      if (position == last)
+        break;
+    }
+
+    /// "bucket" now holds the last point
+    const std::size_t slot = last % kBucketSize;
+    buckets_[found_bucket].x[found_slot] = buckets_[bucket].x[slot];
+    buckets_[found_bucket].y[found_slot] = buckets_[bucket].y[slot];
+    buckets_[found_bucket].id[found_slot] = buckets_[bucket].id[slot];
+    if (slot == 0)
+    {
+      FreeBucket(bucket);
+      if (previous == kNone)
+        nodes_[node].bucket = kNone;
+      else
+        buckets_[previous].next = kNone;
+    }
+  }
+
+  /**
+   * Turn the subtree "node" (whose count is already without "id")
+   * into one leaf with all its points but "id"
+   */
+  void Collapse(std::size_t node, std::size_t id)
+  {
+    const std::size_t bucket = AllocateBucket();
+    std::size_t count = 0;
+    Gather(nodes_[node].child, id, buckets_[bucket], count);
+    nodes_[node].child = kNone;
+    nodes_[node].count = count;
+    if (count > 0)
+      nodes_[node].bucket = bucket;
+    else
+    {
+      nodes_[node].bucket = kNone;
+      FreeBucket(bucket);
+    }
+  }
+
+  /**
+   * Move the points of the four children "child" (but "id") into
+   * "into", and free the children and their buckets
+   */
+  void Gather(std::size_t child, std::size_t id, Bucket& into,
+              std::size_t& count)
+  {
+    for (std::size_t node = child; node < child + 4; ++node)
+    {
+      if (nodes_[node].child != kNone)
+      {
+        Gather(nodes_[node].child, id, into, count);
+        continue;
+      }
+      std::size_t left = nodes_[node].count;
+      for (std::size_t bucket = nodes_[node].bucket; bucket != kNone; )
+      {
+        const Bucket& from = buckets_[bucket];
+        for (std::size_t slot = 0; slot < kBucketSize && left > 0; ++slot)
+        {
+          --left;
+          if (from.id[slot] == id)
+            continue;
+          into.x[count] = from.x[slot];
+          into.y[count] = from.y[slot];
+          into.id[count] = from.id[slot];
+          ++count;
+        }
+        const std::size_t next = from.next;
+        FreeBucket(bucket);
+        bucket = next;
+      }
+    }
+    free_children_.push_back(child);
+  }
+
+  /// L1 distance from (qx, qy) to the nearest point of "node"'s rectangle
+  static float NearDistance(const Node& node, float qx, float qy)
+  {
+    const float dx = (qx < node.min_x) ? node.min_x - qx
+                   : (qx > node.max_x) ? qx - node.max_x : 0.f;
+    const float dy = (qy < node.min_y) ? node.min_y - qy
+                   : (qy > node.max_y) ? qy - node.max_y : 0.f;
+    return dx + dy;
+  }
+
+  /// Upper bound of the L1 distance from (qx, qy) to "node"'s points
+  static float FarDistance(const Node& node, float qx, float qy)
+  {
+    const float dx0 = std::abs(node.min_x - qx);
+    const float dx1 = std::abs(node.max_x - qx);
+    const float dy0 = std::abs(node.min_y - qy);
+    const float dy1 = std::abs(node.max_y - qy);
+    return (dx0 > dx1 ? dx0 : dx1) + (dy0 > dy1 ? dy0 : dy1);
+  }
+
+  void Search(std::size_t node, float qx, float qy, Neighbor& best) const
+  {
+    const Node& current = nodes_[node];
+    if (current.child == kNone)
+    {
+      std::size_t left = current.count;
+      for (std::size_t bucket = current.bucket; bucket != kNone;
+           bucket = buckets_[bucket].next)
+      {
+        const Bucket& points = buckets_[bucket];
+        const std::size_t count = (left < kBucketSize) ? left : kBucketSize;
+        float distances[kBucketSize];
+        ManhattanToPoint(points.x, points.y, count, qx, qy, distances);
+        for (std::size_t slot = 0; slot < count; ++slot)
+          if (distances[slot] < best.distance ||
+              (distances[slot] == best.distance &&
+               points.id[slot] < best.index &&
+               distances[slot] < std::numeric_limits<float>::max()))
+            best = Neighbor{points.id[slot], distances[slot]};
+        left -= count;
+      }
+      return;
+    }
+
+    /// Children nearest first (insertion sort of four)
+    std::size_t order[4];
+    float bounds[4];
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+      const float bound = NearDistance(nodes_[current.child + i], qx, qy);
+      std::size_t j = i;
+      for (; j > 0 && bounds[j-1] > bound; --j)
+      {
+        order[j] = order[j-1];
+        bounds[j] = bounds[j-1];
+      }
+      order[j] = current.child + i;
+      bounds[j] = bound;
+    }
+    for (std::size_t i = 0; i < 4; ++i)
+      if (nodes_[order[i]].count > 0 && bounds[i] <= best.distance)
+        Search(order[i], qx, qy, best);
+  }
+
+  std::size_t Count(std::size_t node, float qx, float qy, float radius) const
+  {
+    const Node& current = nodes_[node];
+    if (current.count == 0 || !(NearDistance(current, qx, qy) < radius))
+      return 0;
+    if (FarDistance(current, qx, qy) < radius)
+      return current.count;
+    if (current.child != kNone)
+      return Count(current.child, qx, qy, radius)
+             + Count(current.child + 1, qx, qy, radius)
+             + Count(current.child + 2, qx, qy, radius)
+             + Count(current.child + 3, qx, qy, radius);
+
+    std::size_t near = 0;
+    std::size_t left = current.count;
+    for (std::size_t bucket = current.bucket; bucket != kNone;
+         bucket = buckets_[bucket].next)
+    {
+      const std::size_t count = (left < kBucketSize) ? left : kBucketSize;
+      near += CountNearPoint(buckets_[bucket].x, buckets_[bucket].y, count,
+                             qx, qy, radius);
+      left -= count;
+    }
+    return near;
+  }
+
+  /// Nodes; the root is nodes_[0], all others come in groups of four
+  std::vector<Node> nodes_;
+  /// First nodes of the free groups of four
+  std::vector<std::size_t> free_children_;
+  std::vector<Bucket> buckets_;
+  /// First free bucket (kNone if none)
+  std::size_t free_bucket_ = kNone;
+
+  /// Positions by id, whether an id is in use, and the free ids
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<unsigned char> live_;
+  std::vector<std::size_t> free_ids_;
+  std::size_t size_;
+};
+
+
+/**
+ * Number of points with an L1 distance to the origin less than
+ * "threshold" (the same as CountNearOrigin over the points)
+ */
+inline std::size_t CountNearOrigin(const Quadtree2d& tree,
+                                   float threshold = 0.5f)
+{
+  return tree.CountWithin(0.f, 0.f, threshold);
+}
+
+
+#endif  // QUADTREE_H
@@ -0,0 +1,232 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QUANTIZEDPOINTCLOUD2D_H
+#define QUANTIZEDPOINTCLOUD2D_H
+
+#include <cmath>     // std::ceil, std::lround
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::int16_t, std::int32_t
+#include <limits>    // std::numeric_limits
+#include <tuple>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "DistanceKernels.h"
+#include "PointCloud2d.h"
+
+
+/**
+ * A set of points in [-1, +1]^2 with int16 fixed-point coordinates
+ *
+ * A coordinate c is stored as q = round(c * kScale), kScale = 32767,
+ * so a point takes 4 bytes: half of a PointCloud2d point, and a
+ * fraction of a heap-allocated Pos2d behind a shared_ptr. Coordinates
+ * outside [-1, +1] are clamped. A point with a NaN coordinate is stored
+ * as missing (kQuantizedMissing, see DistanceKernels.h): like in the
+ * float kernels, it is never near and never nearest, and it decodes
+ * to NaN.
+ *
+ * Quantization error: every stored coordinate is within
+ *   kMaxCoordinateError = 0.5 / 32767 ~ 1.53e-5
+ * of the original one (rounding to the nearest step of 1/32767), and
+ * so every L1 distance to the origin is within
+ *   kMaxDistanceError = 1 / 32767 ~ 3.05e-5
+ * of the distance of the original point.
+ *
+ * The queries work on the int16 values directly: |qx| + |qy| is
+ * computed exactly in integer SIMD lanes, and thresholds are turned
+ * into integer limits once. Results are therefore exact for the
+ * stored (quantized) points; only the conversion to float of a
+ * returned distance rounds.
+ */
+class QuantizedPointCloud2d {
+public:
+  typedef std::vector<std::int16_t,
+                      AlignedAllocator<std::int16_t, kPointCloudAlignment>>
+          Column;
+
+  static constexpr std::int32_t kScale = 32767;
+  static constexpr float kMaxCoordinateError = 0.5f / kScale;
+  static constexpr float kMaxDistanceError = 1.f / kScale;
+
+  QuantizedPointCloud2d() = default;
+
+  /// Quantize all points of "points" (a PointCloud2d or any other set
+  /// with size(), x(i) and y(i))
+  template <typename Points>
+  explicit QuantizedPointCloud2d(const Points& points)
+  : x_(points.size()), y_(points.size())
+  {
+    for (std::size_t i = 0; i < points.size(); ++i)
+      Quantize(points.x(i), points.y(i), x_[i], y_[i]);
+  }
+
+  std::size_t size() const { return x_.size(); }
+  bool empty() const { return x_.empty(); }
+
+  void reserve(std::size_t capacity)
+  {
+    x_.reserve(capacity);
+    y_.reserve(capacity);
+  }
+
+  void clear()
+  {
+    x_.clear();
+    y_.clear();
+  }
+
+  void push_back(float x, float y)
+  {
+    std::int16_t qx;
+    std::int16_t qy;
+    Quantize(x, y, qx, qy);
+    x_.push_back(qx);
+    y_.push_back(qy);
+  }
+
+  /// Decoded coordinates of point "index" (NaN for a missing point)
+  float x(std::size_t index) const { return Decode(x_[index]); }
+  float y(std::size_t index) const { return Decode(y_[index]); }
+
+  /// Raw access to the int16 columns
+  const std::int16_t* x_data() const { return x_.data(); }
+  const std::int16_t* y_data() const { return y_.data(); }
+
+  /// A coordinate; NaN gives kQuantizedMissing
+  static std::int16_t Quantize(float value)
+  {
+    if (!(value == value))
+      return kQuantizedMissing;
+    if (value > 1.f)
+      value = 1.f;
+    if (value < -1.f)
+      value = -1.f;
+    return static_cast<std::int16_t>(std::lround(double(value) * kScale));
+  }
+
+  /// A point; missing as a whole if either coordinate is NaN
+  static void Quantize(float x, float y, std::int16_t& qx, std::int16_t& qy)
+  {
+    qx = Quantize(x);
+    qy = Quantize(y);
+    if (qx == kQuantizedMissing || qy == kQuantizedMissing)
+      qx = qy = kQuantizedMissing;
+  }
+
+  /// A coordinate or a distance, in units of 1/kScale
+  static float Dequantize(std::int32_t value)
+  {
+    return float(value) / float(kScale);
+  }
+
+  /// A coordinate; NaN for kQuantizedMissing
+  static float Decode(std::int16_t value)
+  {
+    return (value == kQuantizedMissing)
+           ? std::numeric_limits<float>::quiet_NaN() : Dequantize(value);
+  }
+
+  /**
+   * The integer limit L such that a quantized L1 distance d (in units
+   * of 1/kScale) is below "threshold" exactly if d < L
+   */
+  static std::int32_t DistanceLimit(float threshold)
+  {
+    /// threshold * kScale is exact in double; d < t*s <=> d < ceil(t*s)
+    const double scaled = std::ceil(double(threshold) * kScale);
+    if (!(scaled > 0.))
+      return 0;
+    if (scaled > 2*kScale + 1)
+      return 2*kScale + 1;
+    return static_cast<std::int32_t>(scaled);
+  }
+
+private:
+  Column x_;
+  Column y_;
+};
+
+
+/**
+ * L1 distance of point "index" to the origin (of the quantized point);
+ * NaN for a missing point
+ */
+inline float ManhattanToOrigin(const QuantizedPointCloud2d& points,
+                               std::size_t index)
+{
+  std::int32_t distance;
+  ManhattanToOrigin(points.x_data() + index, points.y_data() + index, 1,
+                    &distance);
+  if (distance == kQuantizedMissingDistance)
+    return std::numeric_limits<float>::quiet_NaN();
+  return QuantizedPointCloud2d::Dequantize(distance);
+}
+
+
+/**
+ * Exact integer L1 distances of all points, in units of 1/kScale
+ * (kQuantizedMissingDistance for missing points); "distances" must
+ * have room for points.size() values
+ */
+inline void ManhattanToOrigin(const QuantizedPointCloud2d& points,
+                              std::int32_t* distances)
+{
+  ManhattanToOrigin(points.x_data(), points.y_data(), points.size(),
+                    distances);
+}
+
+
+/**
+ * Find the (quantized) point with the smallest L1 distance to the
+ * origin; same rules and results as for PointCloud2d
+ */
+inline std::tuple<std::size_t, float> NearestToOrigin(
+                          const QuantizedPointCloud2d& points
+                                                     )
+{
+  const std::tuple<std::size_t, std::int32_t> nearest =
+    NearestToOrigin(points.x_data(), points.y_data(), points.size());
+  if (std::get<0>(nearest) == points.size())
+    return std::make_tuple(points.size(), std::numeric_limits<float>::max());
+  return std::make_tuple(std::get<0>(nearest),
+    QuantizedPointCloud2d::Dequantize(std::get<1>(nearest)));
+}
+
+
+/**
+ * Count the (quantized) points whose L1 distance to the origin is
+ * less than "threshold"
+ */
+inline std::size_t CountNearOrigin(const QuantizedPointCloud2d& points,
+                                   float threshold = 0.5f)
+{
+  return CountNearOrigin(points.x_data(), points.y_data(), points.size(),
+                         QuantizedPointCloud2d::DistanceLimit(threshold));
+}
+
+
+#endif  // QUANTIZEDPOINTCLOUD2D_H
+
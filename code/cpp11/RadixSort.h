@@ -0,0 +1,146 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint32_t
+#include <vector>
+
+#include "HalfFloat.h"
+#include "TaskScheduler.h"
+
+
+/**
+ * Parallel LSD radix sort of 32-bit keys with a payload
+ *
+ * Four passes, one per key byte (least significant first). Each pass
+ * cuts the input into chunks of kRadixChunkSize, counts the digits of
+ * every chunk in parallel, turns the counts into per-(digit, chunk)
+ * output offsets, and scatters the chunks in parallel. Every pass is
+ * stable, so the whole sort is: equal keys keep their input order. A
+ * pass whose digit is the same for all keys moves nothing and is
+ * skipped.
+ *
+ * Floats sort as their FloatSortKey(), which orders like operator<
+ * does (with -0 before +0, and NaNs at the ends).
+ */
+
+
+/// Keys per chunk of a radix pass
+constexpr std::size_t kRadixChunkSize = std::size_t(1) << 16;
+
+
+/// Unsigned key which orders like the float "value"
+inline std::uint32_t FloatSortKey(float value)
+{
+  const std::uint32_t bits = detail::FloatBits(value);
+  return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+
+/// The float whose FloatSortKey() is "key"
+inline float FloatFromSortKey(std::uint32_t key)
+{
+  return detail::BitsFloat((key & 0x80000000u) ? (key & 0x7fffffffu)
+                                               : ~key);
+}
+
+
+/**
+ * Sort "keys" ascending, and "values" along with them (stable);
+ * both must have the same size
+ */
+template <typename Value>
+void RadixSort(TaskScheduler& scheduler, std::vector<std::uint32_t>& keys,
+               std::vector<Value>& values)
+{
+  constexpr std::size_t kDigits = 256;
+
+  const std::size_t count = keys.size();
+  const std::size_t chunks = (count + kRadixChunkSize - 1) / kRadixChunkSize;
+  std::vector<std::uint32_t> keys_out(count);
+  std::vector<Value> values_out(count);
+  /// offsets[chunk * kDigits + digit]: first, then next output position
+  std::vector<std::size_t> offsets(chunks * kDigits);
+
+  for (unsigned shift = 0; shift < 32; shift += 8)
+  {
+    ParallelForRange(scheduler, 0, chunks, 1,
+      [&](std::size_t first_chunk, std::size_t last_chunk) {
+        for (std::size_t chunk = first_chunk; chunk < last_chunk; ++chunk)
+        {
+          std::size_t* histogram = &offsets[chunk * kDigits];
+          for (std::size_t digit = 0; digit < kDigits; ++digit)
+            histogram[digit] = 0;
+          const std::size_t end = (count - chunk * kRadixChunkSize
+                                   < kRadixChunkSize)
+                                  ? count : (chunk+1) * kRadixChunkSize;
+          for (std::size_t i = chunk * kRadixChunkSize; i < end; ++i)
+            ++histogram[(keys[i] >> shift) & 0xff];
+        }
+      });
+
+    /// Exclusive prefix sum in (digit, chunk) order
+    std::size_t next = 0;
+    bool single_digit = false;
+    for (std::size_t digit = 0; digit < kDigits; ++digit)
+    {
+      const std::size_t digit_begin = next;
+      for (std::size_t chunk = 0; chunk < chunks; ++chunk)
+      {
+        const std::size_t digit_count = offsets[chunk * kDigits + digit];
+        offsets[chunk * kDigits + digit] = next;
+        next += digit_count;
+      }
+      if (next - digit_begin == count)
+        single_digit = true;
+    }
+    if (single_digit)
+      continue;
+
+    ParallelForRange(scheduler, 0, chunks, 1,
+      [&](std::size_t first_chunk, std::size_t last_chunk) {
+        for (std::size_t chunk = first_chunk; chunk < last_chunk; ++chunk)
+        {
+          std::size_t* position = &offsets[chunk * kDigits];
+          const std::size_t end = (count - chunk * kRadixChunkSize
+                                   < kRadixChunkSize)
+                                  ? count : (chunk+1) * kRadixChunkSize;
+          for (std::size_t i = chunk * kRadixChunkSize; i < end; ++i)
+          {
+            const std::size_t out = position[(keys[i] >> shift) & 0xff]++;
+            keys_out[out] = keys[i];
+            values_out[out] = values[i];
+          }
+        }
+      });
+    keys.swap(keys_out);
+    values.swap(values_out);
+  }
+}
+
+
+#endif  // RADIXSORT_H
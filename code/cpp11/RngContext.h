@@ -0,0 +1,208 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RNGCONTEXT_H
+#define RNGCONTEXT_H
+
+#include <atomic>
+#include <cstdint>   // std::uint32_t, std::uint64_t
+#include <limits>    // std::numeric_limits
+#include <random>    // std::random_device
+#include <unordered_map>
+
+#include "Philox.h"
+
+
+/**
+ * One stream of random numbers: the Philox4x32 outputs for the
+ * counters (0, stream), (1, stream), ... under the key "seed"
+ *
+ * Satisfies the C++11 UniformRandomBitGenerator requirements, so it
+ * plugs into the <random> distributions like std::mt19937 does. The
+ * stream of (seed, stream) is always the same sequence, and it can be
+ * repositioned with Seek() to replay from any point.
+ */
+class RngStream {
+public:
+  typedef std::uint32_t result_type;
+
+  explicit RngStream(std::uint64_t seed = 0, std::uint64_t stream = 0)
+  : seed_{seed}, stream_{stream}, position_{0}, block_()
+  { }
+
+  static constexpr result_type min()
+  {
+    return std::numeric_limits<result_type>::min();
+  }
+  static constexpr result_type max()
+  {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()()
+  {
+    if (position_ % 4 == 0)
+      Refill();
+    return block_[position_++ % 4];
+  }
+
+  /// Uniform float in [-1, +1) (see UniformFromBits)
+  float Uniform()
+  {
+    return UniformFromBits((*this)());
+  }
+
+  std::uint64_t seed() const { return seed_; }
+  std::uint64_t stream() const { return stream_; }
+
+  /// Number of values drawn so far
+  std::uint64_t position() const { return position_; }
+
+  /// Continue as if "position" values had been drawn
+  void Seek(std::uint64_t position)
+  {
+    position_ = position;
+    if (position_ % 4 != 0)
+      Refill();
+  }
+
+private:
+  void Refill()
+  {
+    const std::uint64_t block = position_ / 4;
+    block_ = Philox4x32::Generate(
+        Philox4x32::Counter{{static_cast<std::uint32_t>(block),
+                             static_cast<std::uint32_t>(block >> 32),
+                             static_cast<std::uint32_t>(stream_),
+                             static_cast<std::uint32_t>(stream_ >> 32)}},
+        Philox4x32::Key{{static_cast<std::uint32_t>(seed_),
+                         static_cast<std::uint32_t>(seed_ >> 32)}});
+  }
+
+  std::uint64_t seed_;
+  std::uint64_t stream_;
+  std::uint64_t position_;
+  Philox4x32::Counter block_;
+};
+
+
+/**
+ * An explicitly seeded source of independent random streams
+ *
+ *   RngContext rng(seed);          // or RngContext rng; -> random seed
+ *   std::cout << rng.seed();       // record the seed ...
+ *   RngContext replay(rng.seed()); // ... and replay the run exactly
+ *
+ * Stream(k) is the k-th stream of the seed; parallel code that needs
+ * reproducible numbers should derive k from its task or chunk index.
+ * ThreadStream() hands every thread its own stream, numbered in the
+ * order in which threads first ask for one. Threads never share an
+ * engine, so no locking is needed; with a fixed seed a single-threaded
+ * run is reproducible, as is any run where the order of first use is
+ * fixed.
+ *
+ * Thread streams are numbered from kThreadStreamBase upwards, so that
+ * they never overlap with explicitly numbered (small) streams such as
+ * the per-chunk streams of a parallel loop.
+ */
+class RngContext {
+public:
+  static constexpr std::uint64_t kThreadStreamBase = std::uint64_t(1) << 63;
+
+  /// Seed from std::random_device; the seed is recorded in seed()
+  RngContext()
+  : RngContext(RandomSeed())
+  { }
+
+  explicit RngContext(std::uint64_t seed)
+  : seed_{seed}, epoch_{NextEpoch()}, next_thread_stream_{0}
+  { }
+
+  RngContext(const RngContext&) = delete;
+  RngContext& operator=(const RngContext&) = delete;
+
+  std::uint64_t seed() const { return seed_; }
+
+  /// Restart with a new seed; all thread streams start over as well.
+  /// Must not run concurrently with ThreadStream() calls.
+  void Reseed(std::uint64_t seed)
+  {
+    seed_ = seed;
+    epoch_ = NextEpoch();
+    next_thread_stream_ = 0;
+  }
+
+  /// Stream number "stream" of this seed
+  RngStream Stream(std::uint64_t stream) const
+  {
+    return RngStream(seed_, stream);
+  }
+
+  /// The calling thread's own stream of this context
+  RngStream& ThreadStream()
+  {
+    /// One entry per context (epoch) this thread has drawn from
+    static thread_local std::unordered_map<std::uint64_t, RngStream> streams;
+    auto found = streams.find(epoch_);
+    if (found == streams.end())
+      found = streams.emplace(epoch_, Stream(kThreadStreamBase +
+                                             next_thread_stream_++)).first;
+    return found->second;
+  }
+
+  /// 64 bits from std::random_device
+  static std::uint64_t RandomSeed()
+  {
+    std::random_device device;
+    return (std::uint64_t(device()) << 32) | device();
+  }
+
+private:
+  /// Every context (and every reseed) gets a distinct epoch, which
+  /// identifies its thread-local streams
+  static std::uint64_t NextEpoch()
+  {
+    static std::atomic<std::uint64_t> epochs{0};
+    return ++epochs;
+  }
+
+  std::uint64_t seed_;
+  std::atomic<std::uint64_t> epoch_;
+  std::atomic<std::uint64_t> next_thread_stream_;
+};
+
+
+/**
+ * The context behind RandomNumber(); seed it with Reseed() before the
+ * first call to get reproducible numbers
+ */
+inline RngContext& GlobalRngContext()
+{
+  static RngContext context;
+  return context;
+}
+
+
+#endif  // RNGCONTEXT_H
+
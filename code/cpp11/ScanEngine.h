@@ -0,0 +1,452 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SCANENGINE_H
+#define SCANENGINE_H
+
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::int32_t
+#include <limits>    // std::numeric_limits
+#include <tuple>
+#include <vector>
+
+#include "DistanceKernels.h"
+#include "PointCloud2d.h"
+#include "Simd.h"
+
+
+/**
+ * Single-pass, multi-aggregate scans over a set of points
+ *
+ * Every query in main() used to walk all points on its own, so the
+ * data was streamed from memory once per query. Scan() instead walks
+ * the points once, in blocks of kScanBlockSize points. For each block
+ * it computes the distances to the origin, L1 by default (while x and
+ * y are in L1 cache anyway), and hands the block to every aggregate in
+ * turn:
+ *
+ *   CountBelow near_origin(0.5f);
+ *   ArgMinDistance nearest;
+ *   BoundingBox box;
+ *   Scan(points, near_origin, nearest, box);
+ *
+ * Scan<Metric>() scans with the distances of another metric instead
+ * (see Metrics.h); the aggregates below work with any of them.
+ *
+ * The list of aggregates is a template parameter pack, so all calls
+ * are resolved (and inlined) at compile time. An aggregate is any
+ * type with
+ *
+ *   void Consume(const ScanBlock& block);
+ *   void Merge(const Aggregate& later);
+ *
+ * Consume() sees the blocks in index order. Merge() combines the
+ * result of a scan over a later, disjoint index range into this one,
+ * so that aggregates can also be computed per chunk and reduced.
+ */
+
+
+/// Number of points per block (4 KB per column, fits in L1 cache)
+constexpr std::size_t kScanBlockSize = 1024;
+
+
+/**
+ * A block of points handed to the aggregates; point i of the block is
+ * point (offset + i) of the scanned set
+ */
+struct ScanBlock {
+  const float* x;
+  const float* y;
+  const float* distance;
+  std::size_t offset;
+  std::size_t count;
+};
+
+
+/**
+ * Number of points with a distance (under the scan's metric) to the
+ * origin less than "threshold"
+ */
+struct CountBelow {
+  explicit CountBelow(float threshold)
+  : threshold{threshold}, count{0}
+  { }
+
+  void Consume(const ScanBlock& block)
+  {
+    const simd::Float limit = simd::Set1(threshold);
+    std::size_t i = 0;
+    for (; i + simd::kWidth <= block.count; i += simd::kWidth)
+      count += simd::CountTrue(simd::Less(simd::Load(block.distance + i),
+                                          limit));
+    for (; i < block.count; ++i)
+      count += (block.distance[i] < threshold);
+  }
+
+  void Merge(const CountBelow& later)
+  {
+    count += later.count;
+  }
+
+  float threshold;
+  std::size_t count;
+};
+
+
+/**
+ * Index and distance (under the scan's metric) of the point nearest
+ * to the origin; same rules as NearestToOrigin (lowest index wins
+ * ties, the index is std::numeric_limits<std::size_t>::max() if there
+ * is no point)
+ */
+struct ArgMinDistance {
+  ArgMinDistance()
+  : index{std::numeric_limits<std::size_t>::max()},
+    distance{std::numeric_limits<float>::max()}
+  { }
+
+  void Consume(const ScanBlock& block)
+  {
+    std::size_t block_index;
+    float block_distance;
+    std::tie(block_index, block_distance) = ArgMin(block.distance,
+                                                   block.count);
+    if (block_index < block.count && block_distance < distance)
+    {
+      index = block.offset + block_index;
+      distance = block_distance;
+    }
+  }
+
+  void Merge(const ArgMinDistance& later)
+  {
+    if (later.distance < distance ||
+        (later.distance == distance && later.index < index))
+    {
+      index = later.index;
+      distance = later.distance;
+    }
+  }
+
+  std::size_t index;
+  float distance;
+};
+
+
+/**
+ * ArgMinDistance which also keeps the coordinates of the nearest
+ * point, for scans whose points are gone afterwards (e.g. streams)
+ */
+struct NearestPoint {
+  NearestPoint()
+  : x{0.f}, y{0.f}
+  { }
+
+  void Consume(const ScanBlock& block)
+  {
+    const std::size_t previous = nearest.index;
+    nearest.Consume(block);
+    if (nearest.index != previous)
+    {
+      x = block.x[nearest.index - block.offset];
+      y = block.y[nearest.index - block.offset];
+    }
+  }
+
+  void Merge(const NearestPoint& later)
+  {
+    const std::size_t previous = nearest.index;
+    nearest.Merge(later.nearest);
+    if (nearest.index != previous)
+    {
+      x = later.x;
+      y = later.y;
+    }
+  }
+
+  ArgMinDistance nearest;
+  float x;
+  float y;
+};
+
+
+/**
+ * Index and distance (under the scan's metric) of the point farthest
+ * from the origin (lowest index wins ties, the index is
+ * std::numeric_limits<std::size_t>::max() if there is no point)
+ */
+struct ArgMaxDistance {
+  ArgMaxDistance()
+  : index{std::numeric_limits<std::size_t>::max()},
+    distance{-std::numeric_limits<float>::infinity()}
+  { }
+
+  void Consume(const ScanBlock& block)
+  {
+    std::size_t block_index;
+    float block_distance;
+    std::tie(block_index, block_distance) = ArgMax(block.distance,
+                                                   block.count);
+    if (block_index < block.count && block_distance > distance)
+    {
+      index = block.offset + block_index;
+      distance = block_distance;
+    }
+  }
+
+  void Merge(const ArgMaxDistance& later)
+  {
+    if (later.distance > distance ||
+        (later.distance == distance && later.index < index))
+    {
+      index = later.index;
+      distance = later.distance;
+    }
+  }
+
+  std::size_t index;
+  float distance;
+};
+
+
+/**
+ * Sum of the distances (under the scan's metric) of all points to the
+ * origin. Each block is summed in float lanes and added to a double
+ * total.
+ */
+struct SumDistance {
+  SumDistance()
+  : sum{0.}
+  { }
+
+  void Consume(const ScanBlock& block)
+  {
+    simd::Float lane_sum = simd::Set1(0.f);
+    std::size_t i = 0;
+    for (; i + simd::kWidth <= block.count; i += simd::kWidth)
+      lane_sum = simd::Add(lane_sum, simd::Load(block.distance + i));
+    float lane_sums[simd::kWidth];
+    simd::Store(lane_sums, lane_sum);
+    for (std::size_t lane = 0; lane < simd::kWidth; ++lane)
+      sum += lane_sums[lane];
+    for (; i < block.count; ++i)
+      sum += block.distance[i];
+  }
+
+  void Merge(const SumDistance& later)
+  {
+    sum += later.sum;
+  }
+
+  double sum;
+};
+
+
+/**
+ * Axis-aligned bounding box [min_x, max_x] x [min_y, max_y] of the
+ * points (NaN coordinates are ignored). Empty sets give min > max.
+ */
+struct BoundingBox {
+  BoundingBox()
+  : min_x{std::numeric_limits<float>::infinity()},
+    min_y{std::numeric_limits<float>::infinity()},
+    max_x{-std::numeric_limits<float>::infinity()},
+    max_y{-std::numeric_limits<float>::infinity()}
+  { }
+
+  void Consume(const ScanBlock& block)
+  {
+    simd::Float lane_min_x = simd::Set1(min_x);
+    simd::Float lane_min_y = simd::Set1(min_y);
+    simd::Float lane_max_x = simd::Set1(max_x);
+    simd::Float lane_max_y = simd::Set1(max_y);
+    std::size_t i = 0;
+    for (; i + simd::kWidth <= block.count; i += simd::kWidth)
+    {
+      /// New values go first so that NaNs keep the running value
+      const simd::Float x = simd::Load(block.x + i);
+      const simd::Float y = simd::Load(block.y + i);
+      lane_min_x = simd::Min(x, lane_min_x);
+      lane_min_y = simd::Min(y, lane_min_y);
+      lane_max_x = simd::Max(x, lane_max_x);
+      lane_max_y = simd::Max(y, lane_max_y);
+    }
+    float lanes[4][simd::kWidth];
+    simd::Store(lanes[0], lane_min_x);
+    simd::Store(lanes[1], lane_min_y);
+    simd::Store(lanes[2], lane_max_x);
+    simd::Store(lanes[3], lane_max_y);
+    for (std::size_t lane = 0; lane < simd::kWidth; ++lane)
+      Add(lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane]);
+    for (; i < block.count; ++i)
+      Add(block.x[i], block.y[i], block.x[i], block.y[i]);
+  }
+
+  void Merge(const BoundingBox& later)
+  {
+    Add(later.min_x, later.min_y, later.max_x, later.max_y);
+  }
+
+  float min_x;
+  float min_y;
+  float max_x;
+  float max_y;
+
+private:
+  void Add(float lo_x, float lo_y, float hi_x, float hi_y)
+  {
+    if (lo_x < min_x) min_x = lo_x;
+    if (lo_y < min_y) min_y = lo_y;
+    if (hi_x > max_x) max_x = hi_x;
+    if (hi_y > max_y) max_y = hi_y;
+  }
+};
+
+
+/**
+ * Histogram of the distances (under the scan's metric) to the origin:
+ * "bins" equally wide bins over [0, max_distance), plus one last bin
+ * (counts[bins]) for distances >= max_distance and NaNs
+ */
+struct DistanceHistogram {
+  DistanceHistogram(std::size_t bins, float max_distance)
+  : bins{bins}, max_distance{max_distance}, counts(bins+1, 0)
+  { }
+
+  void Consume(const ScanBlock& block)
+  {
+    /// Bin indices are computed in SIMD; the increments cannot be.
+    /// The scale is rounded, so a distance just below max_distance may
+    /// scale to "bins" (it goes to the last bin), and one equal to it
+    /// to just below (it goes to the overflow bin): the comparison
+    /// with max_distance decides, not the scaled value.
+    const float scale = bins / max_distance;
+    const std::size_t last_bin = (bins > 0) ? bins - 1 : 0;
+    const simd::Float lane_scale = simd::Set1(scale);
+    const simd::Float lane_limit = simd::Set1(max_distance);
+    const simd::Float lane_last = simd::Set1(static_cast<float>(last_bin));
+    const simd::Float lane_overflow = simd::Set1(static_cast<float>(bins));
+    std::int32_t bin_of[simd::kWidth];
+    std::size_t i = 0;
+    for (; i + simd::kWidth <= block.count; i += simd::kWidth)
+    {
+      const simd::Float distance = simd::Load(block.distance + i);
+      const simd::Float scaled = simd::Mul(distance, lane_scale);
+      simd::Store(bin_of,
+                  simd::ToInt(simd::Select(simd::Less(distance, lane_limit),
+                                           simd::Min(scaled, lane_last),
+                                           lane_overflow)));
+      for (std::size_t lane = 0; lane < simd::kWidth; ++lane)
+        ++counts[bin_of[lane]];
+    }
+    for (; i < block.count; ++i)
+    {
+      const float distance = block.distance[i];
+      if (distance < max_distance)
+      {
+        const float scaled = distance * scale;
+        ++counts[scaled < last_bin ? static_cast<std::size_t>(scaled)
+                                   : last_bin];
+      }
+      else
+        ++counts[bins];
+    }
+  }
+
+  void Merge(const DistanceHistogram& later)
+  {
+    for (std::size_t bin = 0; bin <= bins; ++bin)
+      counts[bin] += later.counts[bin];
+  }
+
+  std::size_t bins;
+  float max_distance;
+  std::vector<std::size_t> counts;
+};
+
+
+namespace detail {
+
+  /**
+   * Feed the "count" points of the columns "x" and "y" to all
+   * "aggregates"; x[0], y[0] is point number "first_index"
+   */
+  template <typename Metric = L1Metric, typename... Aggregates>
+  void ScanBlocks(const float* x, const float* y, std::size_t count,
+                  std::size_t first_index, Aggregates&... aggregates)
+  {
+    float distance[kScanBlockSize];
+    for (std::size_t i = 0; i < count; i += kScanBlockSize)
+    {
+      const std::size_t block_count = (count - i < kScanBlockSize)
+                                      ? count - i : kScanBlockSize;
+      DistanceToOrigin<Metric>(x + i, y + i, block_count, distance);
+      const ScanBlock block{x + i, y + i, distance,
+                            first_index + i, block_count};
+      /// Call Consume() on every aggregate, in order (C++11 pack expansion)
+      const int expand[] = {0, (aggregates.Consume(block), 0)...};
+      (void)expand;
+    }
+  }
+
+  /**
+   * Feed points [begin, end) of the columns "x" and "y" to all
+   * "aggregates"; block offsets are absolute indices into the columns
+   */
+  template <typename Metric = L1Metric, typename... Aggregates>
+  void ScanRange(const float* x, const float* y,
+                 std::size_t begin, std::size_t end,
+                 Aggregates&... aggregates)
+  {
+    ScanBlocks<Metric>(x + begin, y + begin, end - begin, begin, aggregates...);
+  }
+
+}  // namespace detail
+
+
+/**
+ * Feed points [0, count) to all "aggregates" in a single pass, with
+ * the distances under "Metric"
+ */
+template <typename Metric = L1Metric, typename... Aggregates>
+void Scan(const float* x, const float* y, std::size_t count,
+          Aggregates&... aggregates)
+{
+  detail::ScanRange<Metric>(x, y, 0, count, aggregates...);
+}
+
+
+/**
+ * Feed all points of "points" to all "aggregates" in a single pass
+ */
+template <typename Metric = L1Metric, typename... Aggregates>
+void Scan(const PointCloud2d& points, Aggregates&... aggregates)
+{
+  Scan<Metric>(points.x_data(), points.y_data(), points.size(),
+               aggregates...);
+}
+
+
+#endif  // SCANENGINE_H
+
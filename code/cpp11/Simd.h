@@ -0,0 +1,469 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>     // std::abs, std::fma, std::sqrt
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::int16_t, std::int32_t, std::uint32_t
+#include <cstring>   // std::memcpy
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+  #include <immintrin.h>
+#endif
+
+#include "HalfFloat.h"
+
+
+/**
+ * A very thin layer over the x86 SIMD intrinsics
+ *
+ * The instruction set is picked at compile time from the usual
+ * predefined macros (see ARCHFLAGS in the Makefile):
+ *
+ *   __AVX512F__  ->  16 float lanes (__m512)
+ *   __AVX2__     ->   8 float lanes (__m256)
+ *   __SSE2__     ->   4 float lanes (__m128)
+ *   (none)       ->   1 "lane", plain float
+ *
+ * Kernels are written once against simd::Float (float lanes),
+ * simd::Int (int32 lanes), simd::Mask (result of a comparison) and
+ * the functions below, process simd::kWidth elements per step and
+ * finish with a scalar loop for the remaining elements. All loads
+ * and stores are unaligned, so any sub-range of an array works.
+ *
+ * Float lanes can also be loaded from Float16 and BFloat16 arrays
+ * (see HalfFloat.h); the values are widened to float exactly. Float16
+ * uses the F16C conversion instructions where available (-mf16c, or
+ * any -march that has AVX2). Int lanes can be loaded from int16
+ * arrays, with sign extension.
+ */
+namespace simd {
+
+  /// Whether MulAdd() rounds once (fused multiply-add) or twice
+#if defined(__FMA__) || defined(__AVX512F__)
+  constexpr bool kFusedMulAdd = true;
+#else
+  constexpr bool kFusedMulAdd = false;
+#endif
+
+  /**
+   * a * b + c for the scalar loops, rounded exactly like MulAdd() on
+   * lanes. Writing a * b + c instead would leave it to the compiler
+   * whether to fuse it (GCC does for C++ where the CPU can), so the
+   * lanes and the scalar loops could round differently.
+   */
+  inline float ScalarMulAdd(float a, float b, float c)
+  {
+    return kFusedMulAdd ? std::fma(a, b, c) : a * b + c;
+  }
+
+#if defined(__AVX512F__)
+
+  constexpr const char* kName = "AVX-512";
+  constexpr std::size_t kWidth = 16;
+  typedef __m512 Float;
+  typedef __m512i Int;
+  typedef __mmask16 Mask;
+
+  inline Float Load(const float* p) { return _mm512_loadu_ps(p); }
+  inline void Store(float* p, Float v) { _mm512_storeu_ps(p, v); }
+  inline Float Set1(float v) { return _mm512_set1_ps(v); }
+  inline Float Add(Float a, Float b) { return _mm512_add_ps(a, b); }
+  /// |v| by clearing the IEEE sign bit
+  inline Float Abs(Float v)
+  {
+    return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(v),
+                                                _mm512_set1_epi32(0x7fffffff)));
+  }
+  inline Mask Less(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+  /// Per lane: mask ? a : b
+  inline Float Select(Mask m, Float a, Float b) { return _mm512_mask_blend_ps(m, b, a); }
+  inline Float Mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+  /// a < b ? a : b (b if either is NaN). The full-mask forms (also of
+  /// Sqrt) avoid bogus uninitialized warnings from GCC 12's unmasked
+  /// intrinsics.
+  inline Float Min(Float a, Float b) { return _mm512_mask_min_ps(a, 0xffff, a, b); }
+  /// a > b ? a : b (b if either is NaN)
+  inline Float Max(Float a, Float b) { return _mm512_mask_max_ps(a, 0xffff, a, b); }
+  inline Float Sqrt(Float v) { return _mm512_mask_sqrt_ps(v, 0xffff, v); }
+  /// a * b + c, rounded once (see ScalarMulAdd)
+  inline Float MulAdd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+  /// Number of lanes for which the mask is set
+  inline std::size_t CountTrue(Mask m) { return __builtin_popcount(m); }
+  /// Convert to int32, rounding towards zero
+  inline Int ToInt(Float v)
+  {
+    return _mm512_mask_cvttps_epi32(_mm512_setzero_si512(), 0xffff, v);
+  }
+
+  inline Int Load(const std::int32_t* p) { return _mm512_loadu_si512(p); }
+  inline void Store(std::int32_t* p, Int v) { _mm512_storeu_si512(p, v); }
+  inline Int Set1Int(std::int32_t v) { return _mm512_set1_epi32(v); }
+  inline Int Add(Int a, Int b) { return _mm512_add_epi32(a, b); }
+  inline Int Select(Mask m, Int a, Int b) { return _mm512_mask_blend_epi32(m, b, a); }
+  /// (0, 1, ..., kWidth-1)
+  inline Int LaneIndices()
+  {
+    return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                             8, 9, 10, 11, 12, 13, 14, 15);
+  }
+  inline Int Xor(Int a, Int b) { return _mm512_xor_si512(a, b); }
+  inline Int Or(Int a, Int b) { return _mm512_or_si512(a, b); }
+  /// Logical shifts and rotation of every 32-bit lane (full-mask forms,
+  /// for the same reason as Min/Max)
+  template <int N> Int ShiftLeft(Int v)
+  {
+    return _mm512_mask_slli_epi32(v, 0xffff, v, N);
+  }
+  template <int N> Int ShiftRight(Int v)
+  {
+    return _mm512_mask_srli_epi32(v, 0xffff, v, N);
+  }
+  template <int N> Int RotateLeft(Int v)
+  {
+    return _mm512_mask_rol_epi32(v, 0xffff, v, N);
+  }
+  /// Reinterpret the bits of the int32 lanes as float lanes
+  inline Float AsFloat(Int v) { return _mm512_castsi512_ps(v); }
+  inline Float Sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+
+  /// Widening loads of kWidth 16-bit floats
+  inline Float Load(const Float16* p)
+  {
+    return _mm512_maskz_cvtph_ps(0xffff, _mm256_loadu_si256(
+                                   reinterpret_cast<const __m256i*>(p)));
+  }
+  inline Float Load(const BFloat16* p)
+  {
+    const __m512i widened = _mm512_maskz_cvtepu16_epi32(0xffff,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    return AsFloat(ShiftLeft<16>(widened));
+  }
+
+  /// int16 loads, sign-extended to the int32 lanes
+  inline Int Load(const std::int16_t* p)
+  {
+    return _mm512_maskz_cvtepi16_epi32(0xffff, _mm256_loadu_si256(
+                                         reinterpret_cast<const __m256i*>(p)));
+  }
+  inline Int Abs(Int v) { return _mm512_mask_abs_epi32(v, 0xffff, v); }
+  inline Mask Less(Int a, Int b) { return _mm512_cmplt_epi32_mask(a, b); }
+  /// Convert int32 to float (exact below 2^24)
+  inline Float ToFloat(Int v)
+  {
+    return _mm512_maskz_cvtepi32_ps(0xffff, v);
+  }
+
+#elif defined(__AVX2__)
+
+  constexpr const char* kName = "AVX2";
+  constexpr std::size_t kWidth = 8;
+  typedef __m256 Float;
+  typedef __m256i Int;
+  typedef __m256 Mask;
+
+  inline Float Load(const float* p) { return _mm256_loadu_ps(p); }
+  inline void Store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+  inline Float Set1(float v) { return _mm256_set1_ps(v); }
+  inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+  /// |v| by clearing the IEEE sign bit
+  inline Float Abs(Float v)
+  {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v);
+  }
+  inline Mask Less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  /// Per lane: mask ? a : b
+  inline Float Select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+  inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+  inline Float Sqrt(Float v) { return _mm256_sqrt_ps(v); }
+  /// a * b + c, rounded once if kFusedMulAdd (see ScalarMulAdd)
+  inline Float MulAdd(Float a, Float b, Float c)
+  {
+    #if defined(__FMA__)
+      return _mm256_fmadd_ps(a, b, c);
+    #else
+      return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+    #endif
+  }
+  /// a < b ? a : b (b if either is NaN)
+  inline Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+  /// a > b ? a : b (b if either is NaN)
+  inline Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+  /// Number of lanes for which the mask is set
+  inline std::size_t CountTrue(Mask m)
+  {
+    return __builtin_popcount(_mm256_movemask_ps(m));
+  }
+  /// Convert to int32, rounding towards zero
+  inline Int ToInt(Float v) { return _mm256_cvttps_epi32(v); }
+
+  inline Int Load(const std::int32_t* p)
+  {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  inline void Store(std::int32_t* p, Int v)
+  {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  inline Int Set1Int(std::int32_t v) { return _mm256_set1_epi32(v); }
+  inline Int Add(Int a, Int b) { return _mm256_add_epi32(a, b); }
+  inline Int Select(Mask m, Int a, Int b)
+  {
+    return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b),
+                                                _mm256_castsi256_ps(a), m));
+  }
+  /// (0, 1, ..., kWidth-1)
+  inline Int LaneIndices() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+  inline Int Xor(Int a, Int b) { return _mm256_xor_si256(a, b); }
+  inline Int Or(Int a, Int b) { return _mm256_or_si256(a, b); }
+  /// Logical shifts and rotation of every 32-bit lane
+  template <int N> Int ShiftLeft(Int v) { return _mm256_slli_epi32(v, N); }
+  template <int N> Int ShiftRight(Int v) { return _mm256_srli_epi32(v, N); }
+  template <int N> Int RotateLeft(Int v)
+  {
+    return Or(ShiftLeft<N>(v), ShiftRight<32-N>(v));
+  }
+  /// Reinterpret the bits of the int32 lanes as float lanes
+  inline Float AsFloat(Int v) { return _mm256_castsi256_ps(v); }
+  inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+
+  /// Widening loads of kWidth 16-bit floats
+  inline Float Load(const Float16* p)
+  {
+    #if defined(__F16C__)
+      return _mm256_cvtph_ps(_mm_loadu_si128(
+                               reinterpret_cast<const __m128i*>(p)));
+    #else
+      float widened[kWidth];
+      for (std::size_t lane = 0; lane < kWidth; ++lane)
+        widened[lane] = p[lane];
+      return Load(widened);
+    #endif
+  }
+  inline Float Load(const BFloat16* p)
+  {
+    const __m256i widened = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+                              reinterpret_cast<const __m128i*>(p)));
+    return AsFloat(ShiftLeft<16>(widened));
+  }
+
+  /// int16 loads, sign-extended to the int32 lanes
+  inline Int Load(const std::int16_t* p)
+  {
+    return _mm256_cvtepi16_epi32(_mm_loadu_si128(
+                                   reinterpret_cast<const __m128i*>(p)));
+  }
+  inline Int Abs(Int v) { return _mm256_abs_epi32(v); }
+  inline Mask Less(Int a, Int b)
+  {
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a));
+  }
+  /// Convert int32 to float (exact below 2^24)
+  inline Float ToFloat(Int v) { return _mm256_cvtepi32_ps(v); }
+
+#elif defined(__SSE2__)
+
+  constexpr const char* kName = "SSE2";
+  constexpr std::size_t kWidth = 4;
+  typedef __m128 Float;
+  typedef __m128i Int;
+  typedef __m128 Mask;
+
+  inline Float Load(const float* p) { return _mm_loadu_ps(p); }
+  inline void Store(float* p, Float v) { _mm_storeu_ps(p, v); }
+  inline Float Set1(float v) { return _mm_set1_ps(v); }
+  inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+  /// |v| by clearing the IEEE sign bit
+  inline Float Abs(Float v)
+  {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+  }
+  inline Mask Less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+  /// Per lane: mask ? a : b (SSE2 has no blend instruction)
+  inline Float Select(Mask m, Float a, Float b)
+  {
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+  }
+  inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+  inline Float Sqrt(Float v) { return _mm_sqrt_ps(v); }
+  /// a * b + c, rounded once if kFusedMulAdd (see ScalarMulAdd)
+  inline Float MulAdd(Float a, Float b, Float c)
+  {
+    #if defined(__FMA__)
+      return _mm_fmadd_ps(a, b, c);
+    #else
+      return _mm_add_ps(_mm_mul_ps(a, b), c);
+    #endif
+  }
+  /// a < b ? a : b (b if either is NaN)
+  inline Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+  /// a > b ? a : b (b if either is NaN)
+  inline Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+  /// Number of lanes for which the mask is set
+  inline std::size_t CountTrue(Mask m)
+  {
+    return __builtin_popcount(_mm_movemask_ps(m));
+  }
+  /// Convert to int32, rounding towards zero
+  inline Int ToInt(Float v) { return _mm_cvttps_epi32(v); }
+
+  inline Int Load(const std::int32_t* p)
+  {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  inline void Store(std::int32_t* p, Int v)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  inline Int Set1Int(std::int32_t v) { return _mm_set1_epi32(v); }
+  inline Int Add(Int a, Int b) { return _mm_add_epi32(a, b); }
+  inline Int Select(Mask m, Int a, Int b)
+  {
+    const __m128i mi = _mm_castps_si128(m);
+    return _mm_or_si128(_mm_and_si128(mi, a), _mm_andnot_si128(mi, b));
+  }
+  /// (0, 1, ..., kWidth-1)
+  inline Int LaneIndices() { return _mm_setr_epi32(0, 1, 2, 3); }
+  inline Int Xor(Int a, Int b) { return _mm_xor_si128(a, b); }
+  inline Int Or(Int a, Int b) { return _mm_or_si128(a, b); }
+  /// Logical shifts and rotation of every 32-bit lane
+  template <int N> Int ShiftLeft(Int v) { return _mm_slli_epi32(v, N); }
+  template <int N> Int ShiftRight(Int v) { return _mm_srli_epi32(v, N); }
+  template <int N> Int RotateLeft(Int v)
+  {
+    return Or(ShiftLeft<N>(v), ShiftRight<32-N>(v));
+  }
+  /// Reinterpret the bits of the int32 lanes as float lanes
+  inline Float AsFloat(Int v) { return _mm_castsi128_ps(v); }
+  inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+
+  /// Widening loads of kWidth 16-bit floats
+  inline Float Load(const Float16* p)
+  {
+    #if defined(__F16C__)
+      return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    #else
+      float widened[kWidth];
+      for (std::size_t lane = 0; lane < kWidth; ++lane)
+        widened[lane] = p[lane];
+      return Load(widened);
+    #endif
+  }
+  /// Interleaving zeros below the 16 bits is the same as shifting left
+  inline Float Load(const BFloat16* p)
+  {
+    const __m128i bits = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return AsFloat(_mm_unpacklo_epi16(_mm_setzero_si128(), bits));
+  }
+
+  /// int16 loads, sign-extended to the int32 lanes (duplicate every
+  /// value into both halves of its lane, then shift arithmetically)
+  inline Int Load(const std::int16_t* p)
+  {
+    const __m128i bits = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    return _mm_srai_epi32(_mm_unpacklo_epi16(bits, bits), 16);
+  }
+  /// |v| as (v ^ sign) - sign (SSE2 has no integer abs)
+  inline Int Abs(Int v)
+  {
+    const __m128i sign = _mm_srai_epi32(v, 31);
+    return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+  }
+  inline Mask Less(Int a, Int b) { return _mm_castsi128_ps(_mm_cmplt_epi32(a, b)); }
+  /// Convert int32 to float (exact below 2^24)
+  inline Float ToFloat(Int v) { return _mm_cvtepi32_ps(v); }
+
+#else
+
+  constexpr const char* kName = "scalar";
+  constexpr std::size_t kWidth = 1;
+  typedef float Float;
+  typedef std::int32_t Int;
+  typedef bool Mask;
+
+  inline Float Load(const float* p) { return *p; }
+  inline void Store(float* p, Float v) { *p = v; }
+  inline Float Set1(float v) { return v; }
+  inline Float Add(Float a, Float b) { return a + b; }
+  inline Float Abs(Float v) { return std::abs(v); }
+  inline Mask Less(Float a, Float b) { return a < b; }
+  inline Float Select(Mask m, Float a, Float b) { return m ? a : b; }
+  inline Float Mul(Float a, Float b) { return a * b; }
+  inline Float Sqrt(Float v) { return std::sqrt(v); }
+  inline Float MulAdd(Float a, Float b, Float c) { return ScalarMulAdd(a, b, c); }
+  inline Float Min(Float a, Float b) { return a < b ? a : b; }
+  inline Float Max(Float a, Float b) { return a > b ? a : b; }
+  inline std::size_t CountTrue(Mask m) { return m ? 1 : 0; }
+  inline Int ToInt(Float v) { return static_cast<Int>(v); }
+
+  inline Int Load(const std::int32_t* p) { return *p; }
+  inline void Store(std::int32_t* p, Int v) { *p = v; }
+  inline Int Set1Int(std::int32_t v) { return v; }
+  /// Wraps around like the SIMD versions (signed overflow would be UB)
+  inline Int Add(Int a, Int b)
+  {
+    return static_cast<Int>(static_cast<std::uint32_t>(a) +
+                            static_cast<std::uint32_t>(b));
+  }
+  inline Int Select(Mask m, Int a, Int b) { return m ? a : b; }
+  inline Int LaneIndices() { return 0; }
+  inline Int Xor(Int a, Int b) { return a ^ b; }
+  inline Int Or(Int a, Int b) { return a | b; }
+  template <int N> Int ShiftLeft(Int v)
+  {
+    return static_cast<Int>(static_cast<std::uint32_t>(v) << N);
+  }
+  template <int N> Int ShiftRight(Int v)
+  {
+    return static_cast<Int>(static_cast<std::uint32_t>(v) >> N);
+  }
+  template <int N> Int RotateLeft(Int v)
+  {
+    return Or(ShiftLeft<N>(v), ShiftRight<32-N>(v));
+  }
+  inline Float AsFloat(Int v)
+  {
+    float f;
+    std::memcpy(&f, &v, sizeof(f));
+    return f;
+  }
+  inline Float Sub(Float a, Float b) { return a - b; }
+
+  inline Float Load(const Float16* p) { return *p; }
+  inline Float Load(const BFloat16* p) { return *p; }
+
+  inline Int Load(const std::int16_t* p) { return *p; }
+  /// Callers keep |v| below 2^31 (abs(INT32_MIN) would be UB)
+  inline Int Abs(Int v) { return v < 0 ? -v : v; }
+  inline Mask Less(Int a, Int b) { return a < b; }
+  inline Float ToFloat(Int v) { return static_cast<Float>(v); }
+
+#endif
+
+}  // namespace simd
+
+
+#endif  // SIMD_H
+
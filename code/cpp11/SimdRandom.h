@@ -0,0 +1,138 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SIMDRANDOM_H
+#define SIMDRANDOM_H
+
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint32_t, std::uint64_t
+#include <cstring>   // std::memcpy
+
+#include "Philox.h"
+#include "Simd.h"
+
+
+/**
+ * Bulk generator of uniform floats in [-1, +1)
+ *
+ * Runs kLanes = 16 independent xoshiro128+ generators (Blackman and
+ * Vigna) side by side, one per 32-bit SIMD lane: one AVX-512 vector,
+ * two AVX2 vectors, four SSE2 vectors or 16 scalars, depending on the
+ * build. Output number i comes from generator i % 16, so the
+ * sequence is the same for every instruction set.
+ *
+ * A float is made without any int-to-float conversion: the top 23
+ * random bits become the mantissa of a float with exponent 1, which
+ * is a number in [2, 4), and subtracting 3 gives [-1, +1) in steps
+ * of 2^-22.
+ *
+ * The 16 generator states are derived from (seed, stream) through
+ * Philox4x32, so different streams are independent and any stream
+ * can be reconstructed from its seed.
+ */
+class UniformFloatGenerator {
+public:
+  static constexpr std::size_t kLanes = 16;
+
+  explicit UniformFloatGenerator(std::uint64_t seed, std::uint64_t stream = 0)
+  {
+    const Philox4x32::Key key{{static_cast<std::uint32_t>(seed),
+                               static_cast<std::uint32_t>(seed >> 32)}};
+    for (std::size_t lane = 0; lane < kLanes; ++lane)
+    {
+      /// counter[1]'s top bit keeps these counters apart from RngStream's
+      const Philox4x32::Counter words = Philox4x32::Generate(
+          Philox4x32::Counter{{static_cast<std::uint32_t>(lane), 0x80000000u,
+                               static_cast<std::uint32_t>(stream),
+                               static_cast<std::uint32_t>(stream >> 32)}},
+          key);
+      for (std::size_t word = 0; word < 4; ++word)
+        state_[word][lane] = static_cast<std::int32_t>(words[word]);
+      /// xoshiro128+ must not start from the all-zero state
+      if ((words[0] | words[1] | words[2] | words[3]) == 0)
+        state_[0][lane] = 1;
+    }
+  }
+
+  /**
+   * Write "count" uniform numbers in [-1, +1) to "out". If count is
+   * not a multiple of kLanes, the unused rest of the last step is
+   * dropped, so a later Fill() continues with a fresh step.
+   */
+  void Fill(float* out, std::size_t count)
+  {
+    constexpr std::size_t kVectors = kLanes / simd::kWidth;
+    static_assert(kLanes % simd::kWidth == 0,
+                  "'UniformFloatGenerator' needs kWidth to divide kLanes!");
+
+    simd::Int s[4][kVectors];
+    for (std::size_t word = 0; word < 4; ++word)
+      for (std::size_t v = 0; v < kVectors; ++v)
+        s[word][v] = simd::Load(&state_[word][v * simd::kWidth]);
+
+    std::size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes)
+      Step(s, out + i);
+    if (i < count)
+    {
+      float rest[kLanes];
+      Step(s, rest);
+      std::memcpy(out + i, rest, (count - i) * sizeof(float));
+    }
+
+    for (std::size_t word = 0; word < 4; ++word)
+      for (std::size_t v = 0; v < kVectors; ++v)
+        simd::Store(&state_[word][v * simd::kWidth], s[word][v]);
+  }
+
+private:
+  /// One xoshiro128+ step of all lanes; writes kLanes floats to "out"
+  template <std::size_t kVectors>
+  static void Step(simd::Int (&s)[4][kVectors], float* out)
+  {
+    const simd::Int exponent = simd::Set1Int(0x40000000);  // 2.f
+    const simd::Float three = simd::Set1(3.f);
+    for (std::size_t v = 0; v < kVectors; ++v)
+    {
+      const simd::Int result = simd::Add(s[0][v], s[3][v]);
+      const simd::Float in_2_4 = simd::AsFloat(
+          simd::Or(simd::ShiftRight<9>(result), exponent));
+      simd::Store(out + v * simd::kWidth, simd::Sub(in_2_4, three));
+
+      const simd::Int t = simd::ShiftLeft<9>(s[1][v]);
+      s[2][v] = simd::Xor(s[2][v], s[0][v]);
+      s[3][v] = simd::Xor(s[3][v], s[1][v]);
+      s[1][v] = simd::Xor(s[1][v], s[2][v]);
+      s[0][v] = simd::Xor(s[0][v], s[3][v]);
+      s[2][v] = simd::Xor(s[2][v], t);
+      s[3][v] = simd::RotateLeft<11>(s[3][v]);
+    }
+  }
+
+  std::int32_t state_[4][kLanes];
+};
+
+
+#endif  // SIMDRANDOM_H
+
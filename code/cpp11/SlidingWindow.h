@@ -0,0 +1,270 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SLIDINGWINDOW_H
+#define SLIDINGWINDOW_H
+
+#include <cmath>     // std::abs
+#include <cstddef>   // std::size_t
+#include <limits>    // std::numeric_limits
+#include <stdexcept> // std::runtime_error
+#include <vector>
+
+#include "NearestK.h"
+#include "ScanEngine.h"
+
+
+namespace detail {
+
+/**
+ * A FIFO queue in one array used as a ring, with access at both ends
+ * and by position (0 is the front); grows (doubling) when full, and
+ * never shrinks
+ */
+template <typename T>
+class RingBuffer {
+public:
+  RingBuffer()
+  : items_(kInitialCapacity), head_{0}, size_{0}
+  { }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const T& operator[](std::size_t i) const
+  {
+    return items_[(head_ + i) & (items_.size() - 1)];
+  }
+  const T& front() const { return (*this)[0]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  void push_back(const T& item)
+  {
+    if (size_ == items_.size())
+    {
+      std::vector<T> items(2 * items_.size());
+      for (std::size_t i = 0; i < size_; ++i)
+        items[i] = (*this)[i];
+      items_.swap(items);
+      head_ = 0;
+    }
+    items_[(head_ + size_) & (items_.size() - 1)] = item;
+    ++size_;
+  }
+
+  void pop_front()
+  {
+    head_ = (head_ + 1) & (items_.size() - 1);
+    --size_;
+  }
+
+  void pop_back() { --size_; }
+
+private:
+  /// A power of two, as every capacity
+  static constexpr std::size_t kInitialCapacity = 16;
+
+  std::vector<T> items_;
+  std::size_t head_;
+  std::size_t size_;
+};
+
+}  // namespace detail
+
+
+/**
+ * Near-origin count and nearest point of the most recent points of a
+ * stream: the last max_points() points, of which only those less than
+ * max_age() (seconds, or any time unit) older than the newest
+ *
+ * Recomputing the statistics of the window on each arrival costs
+ * O(window size); here each arrival costs amortised O(1), and the
+ * queries O(1):
+ *
+ * - The window's points sit in a ring buffer, oldest first. The
+ *   near-origin count goes up when a near point arrives and down when
+ *   it leaves.
+ * - The nearest point comes from a monotonic deque: the window's
+ *   points that no later point is nearer than, oldest (and so
+ *   nearest) first. An arrival removes the candidates at the back
+ *   which are farther than it is (they can never be the nearest
+ *   again, since it leaves later); a departure removes the front if it
+ *   is the leaving point. The front is the nearest point of the
+ *   window. Every arrival enters and leaves the deque at most once.
+ *
+ * Points are numbered by arrival (from 0). Distances and ties follow
+ * NearestToOrigin: float L1 distances, the lowest number (oldest
+ * point) wins ties, and only distances below
+ * std::numeric_limits<float>::max() count.
+ *
+ * Count windows also work as a Scan() aggregate (Consume() only), e.g.
+ * in ScanStream(); given all blocks, the arrival numbers are the point
+ * indices.
+ */
+class SlidingWindow {
+public:
+  /// max_points() of a window limited only by age
+  static constexpr std::size_t kUnlimited =
+    std::numeric_limits<std::size_t>::max();
+
+  /**
+   * A window of the last "max_points" points; with a finite "max_age",
+   * also only of those less than "max_age" older than the newest.
+   * Counts points nearer to the origin than "threshold".
+   */
+  explicit SlidingWindow(
+      std::size_t max_points,
+      double max_age = std::numeric_limits<double>::infinity(),
+      float threshold = 0.5f)
+  : max_points_{max_points}, max_age_{max_age}, threshold_{threshold},
+    first_{0}, near_{0}, latest_{-std::numeric_limits<double>::infinity()}
+  { }
+
+  std::size_t max_points() const { return max_points_; }
+  double max_age() const { return max_age_; }
+  float threshold() const { return threshold_; }
+
+  /// Number of points in the window
+  std::size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+  /// Arrival number of the oldest point in the window, and of the next
+  /// point to arrive; the window holds the points [first(), arrivals())
+  std::size_t first() const { return first_; }
+  std::size_t arrivals() const { return first_ + entries_.size(); }
+
+  /// Position, distance and time of point "index" of the window
+  float x(std::size_t index) const { return At(index).x; }
+  float y(std::size_t index) const { return At(index).y; }
+  float distance(std::size_t index) const { return At(index).distance; }
+  double time(std::size_t index) const { return At(index).time; }
+
+  /**
+   * Add the point (x, y) arriving at "time"; times must not decrease.
+   * Points that are now too old, or too many, leave the window.
+   */
+  void Push(float x, float y, double time = 0.)
+  {
+    Push(x, y, std::abs(x) + std::abs(y), time);
+  }
+
+  /// Let the points leave that are too old at "time" (when no point
+  /// arrives for a while)
+  void Expire(double time)
+  {
+    Advance(time);
+    while (!entries_.empty() && !(time - entries_.front().time < max_age_))
+      PopFront();
+  }
+
+  /// Number of points in the window with a distance less than
+  /// threshold()
+  std::size_t CountNear() const { return near_; }
+
+  /**
+   * Arrival number and distance of the window's point nearest to the
+   * origin; without one (e.g. for an empty window) the index is
+   * arrivals() and the distance is std::numeric_limits<float>::max()
+   */
+  Neighbor Nearest() const
+  {
+    if (candidates_.empty())
+      return Neighbor{arrivals(), std::numeric_limits<float>::max()};
+    const std::size_t index = candidates_.front();
+    return Neighbor{index, At(index).distance};
+  }
+
+  /// Scan() aggregate interface: push the block's points (at time 0)
+  void Consume(const ScanBlock& block)
+  {
+    for (std::size_t i = 0; i < block.count; ++i)
+      Push(block.x[i], block.y[i], block.distance[i], 0.);
+  }
+
+private:
+  struct WindowEntry {
+    float x;
+    float y;
+    float distance;
+    double time;
+  };
+
+  const WindowEntry& At(std::size_t index) const
+  {
+    return entries_[index - first_];
+  }
+
+  /// Make "time" the latest time
+  void Advance(double time)
+  {
+    if (!(time >= latest_))
+      throw std::runtime_error("SlidingWindow: time went backwards");
+    latest_ = time;
+  }
+
+  void Push(float x, float y, float distance, double time)
+  {
+    Advance(time);
+    const std::size_t index = arrivals();
+    entries_.push_back(WindowEntry{x, y, distance, time});
+    near_ += (distance < threshold_);
+    if (distance < std::numeric_limits<float>::max())
+    {
+      while (!candidates_.empty() &&
+             At(candidates_.back()).distance > distance)
+        candidates_.pop_back();
+      candidates_.push_back(index);
+    }
+    while (entries_.size() > max_points_)
+      PopFront();
+    Expire(time);
+  }
+
+  /// Let the oldest point leave the window
+  void PopFront()
+  {
+    near_ -= (entries_.front().distance < threshold_);
+    if (!candidates_.empty() && candidates_.front() == first_)
+      candidates_.pop_front();
+    entries_.pop_front();
+    ++first_;
+  }
+
+  std::size_t max_points_;
+  double max_age_;
+  float threshold_;
+
+  /// The window's points, oldest (arrival number first_) first
+  detail::RingBuffer<WindowEntry> entries_;
+  /// Arrival numbers of the candidates for the nearest point; their
+  /// distances do not decrease from front to back
+  detail::RingBuffer<std::size_t> candidates_;
+  std::size_t first_;
+  std::size_t near_;
+  /// Time of the latest Push() or Expire()
+  double latest_;
+};
+
+
+#endif  // SLIDINGWINDOW_H
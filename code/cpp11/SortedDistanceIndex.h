@@ -0,0 +1,151 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SORTEDDISTANCEINDEX_H
+#define SORTEDDISTANCEINDEX_H
+
+#include <algorithm> // std::lower_bound
+#include <cmath>     // std::abs, std::isnan
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint32_t
+#include <vector>
+
+#include "DistanceKernels.h"
+#include "RadixSort.h"
+#include "TaskScheduler.h"
+
+
+/**
+ * The distances of a point set to the origin under "Metric" (see
+ * Metrics.h), in ascending order; SortedDistanceIndex for the L1
+ * distances
+ *
+ * Building the index computes all distances (SIMD, in parallel) and
+ * radix sorts them together with the point indices (see RadixSort.h);
+ * the sort is stable, so equally distant points stay in index order.
+ * After that, a near-origin count for any threshold is one binary
+ * search instead of a scan over all points:
+ *
+ *   const SortedDistanceIndex index(scheduler, points);
+ *   for (float threshold: thresholds)
+ *     std::cout << CountNearOrigin(index, threshold) << "\n";
+ *
+ * The points with a distance in [low, high) are the contiguous range
+ * [LowerBound(low), LowerBound(high)) of index() and distance().
+ * Points whose distance is NaN can never be near, and are left out.
+ */
+template <typename Metric>
+class BasicSortedDistanceIndex {
+public:
+  BasicSortedDistanceIndex() = default;
+
+  /// Build over "points" (anything with size(), x_data() and y_data())
+  template <typename Points>
+  BasicSortedDistanceIndex(TaskScheduler& scheduler, const Points& points)
+  {
+    const std::size_t count = points.size();
+    std::vector<std::uint32_t> keys(count);
+    std::vector<std::size_t> indices(count);
+    distances_.resize(count);
+    ParallelForRange(scheduler, 0, count, kRadixChunkSize,
+      [&](std::size_t begin, std::size_t end) {
+        DistanceToOrigin<Metric>(points.x_data() + begin,
+                                 points.y_data() + begin, end - begin,
+                                 distances_.data() + begin);
+        for (std::size_t i = begin; i < end; ++i)
+        {
+          /// Distances are >= +0 or NaN; std::abs clears the sign of
+          /// NaNs, so that they all sort last
+          keys[i] = FloatSortKey(std::abs(distances_[i]));
+          indices[i] = i;
+        }
+      });
+    RadixSort(scheduler, keys, indices);
+
+    /// Drop the NaNs
+    std::size_t size = count;
+    while (size > 0 && std::isnan(FloatFromSortKey(keys[size-1])))
+      --size;
+    distances_.resize(size);
+    for (std::size_t i = 0; i < size; ++i)
+      distances_[i] = FloatFromSortKey(keys[i]);
+    indices.resize(size);
+    indices_.swap(indices);
+  }
+
+  /// Number of points in the index
+  std::size_t size() const { return distances_.size(); }
+  bool empty() const { return distances_.empty(); }
+
+  /// Index (in the point set) and distance of the i-th nearest point
+  std::size_t index(std::size_t i) const { return indices_[i]; }
+  float distance(std::size_t i) const { return distances_[i]; }
+
+  const std::size_t* index_data() const { return indices_.data(); }
+  const float* distance_data() const { return distances_.data(); }
+
+  /// Number of points with a distance less than "distance"; also the
+  /// position of the first one that is not
+  std::size_t LowerBound(float distance) const
+  {
+    return std::lower_bound(distances_.begin(), distances_.end(), distance)
+           - distances_.begin();
+  }
+
+private:
+  std::vector<float> distances_;
+  std::vector<std::size_t> indices_;
+};
+
+typedef BasicSortedDistanceIndex<L1Metric> SortedDistanceIndex;
+
+
+/**
+ * Number of points with a distance to the origin less than
+ * "threshold" (the same as CountNearOrigin over the points, with the
+ * index's metric), in O(log n)
+ */
+template <typename Metric>
+std::size_t CountNearOrigin(const BasicSortedDistanceIndex<Metric>& index,
+                            float threshold = 0.5f)
+{
+  return index.LowerBound(threshold);
+}
+
+
+/**
+ * Number of points with a distance to the origin in [low, high) (none
+ * if low >= high, or if either is NaN)
+ */
+template <typename Metric>
+std::size_t CountInAnnulus(const BasicSortedDistanceIndex<Metric>& index,
+                           float low, float high)
+{
+  if (!(low < high))
+    return 0;
+  return index.LowerBound(high) - index.LowerBound(low);
+}
+
+
+#endif  // SORTEDDISTANCEINDEX_H
@@ -0,0 +1,376 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>   // std::size_t
+#include <deque>
+#include <exception> // std::exception_ptr
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class TaskGroup;
+
+
+/**
+ * A work-stealing task scheduler
+ *
+ * Every worker thread owns a deque of tasks. New tasks go to the back
+ * of the deque of the thread that creates them, and a worker takes
+ * its next task from the back as well (newest first, which keeps the
+ * data of a recursive split in cache). A worker whose deque is empty
+ * steals the *oldest* task from the front of a randomly chosen
+ * victim. In a recursive fork/join split the oldest tasks are the
+ * biggest pieces of work, so a few steals are enough to balance the
+ * load, even when some pieces turn out much cheaper than others.
+ *
+ * Tasks are submitted and waited for through a TaskGroup. Threads
+ * which are not workers (e.g. main()) can submit tasks too; they wait
+ * by stealing and running tasks themselves. An exception thrown by a
+ * task is passed on to the thread which waits for its group.
+ */
+class TaskScheduler {
+public:
+  /// "threads" worker threads; 0 means one per core
+  explicit TaskScheduler(std::size_t threads = 0)
+  : queued_{0}, stop_{false}, next_victim_{0}
+  {
+    if (threads == 0)
+      threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+      threads = 1;
+    for (std::size_t i = 0; i < threads; ++i)
+      queues_.emplace_back(new Queue);
+    for (std::size_t i = 0; i < threads; ++i)
+      threads_.emplace_back([this, i]{ WorkerLoop(i); });
+  }
+
+  ~TaskScheduler()
+  {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread: threads_)
+      thread.join();
+  }
+
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+  /// Number of worker threads
+  std::size_t size() const { return queues_.size(); }
+
+private:
+  friend class TaskGroup;
+
+  struct Task {
+    std::function<void()> function;
+    TaskGroup* group;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  /// Which scheduler and queue the current thread works for
+  struct ThreadContext {
+    const TaskScheduler* scheduler;
+    std::size_t index;
+    unsigned int random_state;
+  };
+  static ThreadContext& Context()
+  {
+    static thread_local ThreadContext context{nullptr, 0, 0};
+    return context;
+  }
+
+  /// Index of the calling thread's queue, or size() for non-workers
+  std::size_t Self() const
+  {
+    return (Context().scheduler == this) ? Context().index : size();
+  }
+
+  void Push(Task task)
+  {
+    std::size_t target = Self();
+    if (target == size())
+      target = next_victim_++ % size();
+    {
+      std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+      queues_[target]->tasks.push_back(std::move(task));
+    }
+    ++queued_;
+    {
+      /// Taking the lock orders this against a worker going to sleep
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+  }
+
+  /// Find a task (own queue first, then steal) and run it
+  bool RunOne(std::size_t self);
+
+  void WorkerLoop(std::size_t index)
+  {
+    Context() = ThreadContext{this, index, 0};
+    for (;;)
+    {
+      if (RunOne(index))
+        continue;
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      wake_.wait(lock, [this]{ return stop_ || queued_ > 0; });
+      if (stop_)
+        return;
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  /// Tasks currently sitting in any queue
+  std::atomic<std::size_t> queued_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  /// Round-robin target for tasks pushed by non-worker threads
+  std::atomic<std::size_t> next_victim_;
+};
+
+
+/**
+ * A set of tasks which can be waited for as a whole
+ *
+ *   TaskGroup group(scheduler);
+ *   group.Run([&]{ ... });
+ *   group.Run([&]{ ... });
+ *   group.Wait();
+ *
+ * While waiting, the calling thread runs queued tasks (its own or
+ * stolen ones) instead of blocking. If tasks of the group threw,
+ * Wait() rethrows the first of those exceptions once all tasks are
+ * done. The destructor waits as well, but drops such an exception.
+ */
+class TaskGroup {
+public:
+  explicit TaskGroup(TaskScheduler& scheduler)
+  : scheduler_(scheduler), pending_{0}, error_{nullptr}
+  { }
+
+  ~TaskGroup() { WaitForTasks(); }
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  template <typename Function>
+  void Run(Function&& function)
+  {
+    ++pending_;
+    try
+    {
+      scheduler_.Push(TaskScheduler::Task{std::forward<Function>(function),
+                                          this});
+    }
+    catch (...)
+    {
+      --pending_;
+      throw;
+    }
+  }
+
+  void Wait()
+  {
+    WaitForTasks();
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock(error_mutex_);
+      error.swap(error_);
+    }
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+private:
+  friend class TaskScheduler;
+
+  void WaitForTasks()
+  {
+    const std::size_t self = scheduler_.Self();
+    while (pending_ > 0)
+      if (!scheduler_.RunOne(self))
+        std::this_thread::yield();
+  }
+
+  /// Keep the first exception thrown by a task of this group
+  void Fail(std::exception_ptr error)
+  {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (!error_)
+      error_ = error;
+  }
+
+  TaskScheduler& scheduler_;
+  std::atomic<std::size_t> pending_;
+  std::mutex error_mutex_;
+  std::exception_ptr error_;
+};
+
+
+inline bool TaskScheduler::RunOne(std::size_t self)
+{
+  Task task{nullptr, nullptr};
+  bool found = false;
+
+  /// Own queue: newest task first
+  if (self < size())
+  {
+    std::lock_guard<std::mutex> lock(queues_[self]->mutex);
+    if (!queues_[self]->tasks.empty())
+    {
+      task = std::move(queues_[self]->tasks.back());
+      queues_[self]->tasks.pop_back();
+      found = true;
+    }
+  }
+
+  /// Steal the oldest task of random victims
+  if (!found && queued_ > 0)
+  {
+    unsigned int& random_state = Context().random_state;
+    if (random_state == 0)
+    {
+      const std::size_t id = std::hash<std::thread::id>()(
+                               std::this_thread::get_id());
+      random_state = static_cast<unsigned int>(id) | 1u;
+    }
+    for (std::size_t attempt = 0; attempt < 2*size() && !found; ++attempt)
+    {
+      /// xorshift32; the state is only ever used from this thread
+      random_state ^= random_state << 13;
+      random_state ^= random_state >> 17;
+      random_state ^= random_state << 5;
+      const std::size_t victim = random_state % size();
+      if (victim == self)
+        continue;
+      std::lock_guard<std::mutex> lock(queues_[victim]->mutex);
+      if (!queues_[victim]->tasks.empty())
+      {
+        task = std::move(queues_[victim]->tasks.front());
+        queues_[victim]->tasks.pop_front();
+        found = true;
+      }
+    }
+  }
+
+  if (!found)
+    return false;
+
+  --queued_;
+  try
+  {
+    task.function();
+  }
+  catch (...)
+  {
+    task.group->Fail(std::current_exception());
+  }
+  --task.group->pending_;
+  return true;
+}
+
+
+/**
+ * Run "first" and "second" in parallel and return when both are done
+ */
+template <typename First, typename Second>
+void ParallelInvoke(TaskScheduler& scheduler,
+                    const First& first, const Second& second)
+{
+  TaskGroup group(scheduler);
+  group.Run([&]{ second(); });
+  first();
+  group.Wait();
+}
+
+
+/**
+ * Call body(b, e) on subranges [b, e) which together cover [begin, end)
+ *
+ * The range is split in halves recursively (fork/join) until pieces
+ * are at most "grain" long. The split points depend only on begin,
+ * end and grain, never on the number of threads.
+ */
+template <typename Body>
+void ParallelForRange(TaskScheduler& scheduler,
+                      std::size_t begin, std::size_t end, std::size_t grain,
+                      const Body& body)
+{
+  if (end - begin <= grain || end - begin < 2)
+  {
+    if (begin < end)
+      body(begin, end);
+    return;
+  }
+  const std::size_t middle = begin + (end - begin) / 2;
+  ParallelInvoke(scheduler,
+                 [&]{ ParallelForRange(scheduler, begin, middle, grain, body); },
+                 [&]{ ParallelForRange(scheduler, middle, end, grain, body); });
+}
+
+
+/**
+ * Reduce [begin, end) with the same recursive split as ParallelForRange:
+ * leaves compute map(b, e), and two neighbouring results are combined
+ * as combine(left, right), always left before right. "identity" seeds
+ * the result slots and is returned for an empty range.
+ */
+template <typename T, typename Map, typename Combine>
+T ParallelReduce(TaskScheduler& scheduler,
+                 std::size_t begin, std::size_t end, std::size_t grain,
+                 const T& identity, const Map& map, const Combine& combine)
+{
+  if (end - begin <= grain || end - begin < 2)
+    return (begin < end) ? map(begin, end) : identity;
+  const std::size_t middle = begin + (end - begin) / 2;
+  T left(identity);
+  T right(identity);
+  ParallelInvoke(scheduler,
+    [&]{ left = ParallelReduce(scheduler, begin, middle, grain,
+                               identity, map, combine); },
+    [&]{ right = ParallelReduce(scheduler, middle, end, grain,
+                                identity, map, combine); });
+  return combine(left, right);
+}
+
+
+#endif  // TASKSCHEDULER_H
+
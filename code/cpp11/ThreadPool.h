@@ -0,0 +1,196 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>   // std::size_t
+#include <exception> // std::exception_ptr
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * A fixed set of worker threads which live as long as the pool
+ *
+ * The only operation is ParallelFor(count, task), which calls task(i)
+ * for every i in [0, count), spread over the workers *and* the calling
+ * thread, and returns when all calls are done. Indices are handed out
+ * one at a time from a shared atomic counter, so give each index a
+ * decent chunk of work (tens of thousands of points, not one).
+ *
+ * Only one ParallelFor runs at a time; concurrent calls from other
+ * threads queue up. A ParallelFor issued from inside a task runs
+ * serially on the calling worker instead of deadlocking.
+ *
+ * If a task throws (on any thread), no further indices are handed
+ * out; ParallelFor waits for the calls still running and then
+ * rethrows the first exception on the calling thread.
+ */
+class ThreadPool {
+public:
+  /// "threads" includes the calling thread; 0 means one per core
+  explicit ThreadPool(std::size_t threads = 0)
+  : job_count_{0}, next_index_{0}, busy_workers_{0},
+    generation_{0}, stop_{false}, error_{nullptr}
+  {
+    if (threads == 0)
+      threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+      threads = 1;
+    for (std::size_t i = 1; i < threads; ++i)
+      workers_.emplace_back([this]{ WorkerLoop(); });
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker: workers_)
+      worker.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Number of threads working on a ParallelFor (workers + caller)
+  std::size_t size() const { return workers_.size() + 1; }
+
+  template <typename Task>
+  void ParallelFor(std::size_t count, const Task& task)
+  {
+    if (count == 0)
+      return;
+    if (InsideTask() || workers_.empty() || count == 1)
+    {
+      for (std::size_t i = 0; i < count; ++i)
+        task(i);
+      return;
+    }
+
+    std::lock_guard<std::mutex> serialize(job_mutex_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = std::function<void(std::size_t)>(std::cref(task));
+      job_count_ = count;
+      next_index_ = 0;
+      busy_workers_ = workers_.size();
+      ++generation_;
+    }
+    wake_.notify_all();
+
+    RunJob();
+
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_.wait(lock, [this]{ return busy_workers_ == 0; });
+      job_ = nullptr;
+      error.swap(error_);
+    }
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+private:
+  static bool& InsideTask()
+  {
+    static thread_local bool inside_task = false;
+    return inside_task;
+  }
+
+  /// Take indices of the current job until there are none left, or
+  /// until a task throws (then keep the first exception for
+  /// ParallelFor, and hand out no more indices)
+  void RunJob()
+  {
+    InsideTask() = true;
+    try
+    {
+      for (std::size_t i = next_index_++; i < job_count_;
+           i = next_index_++)
+        job_(i);
+    }
+    catch (...)
+    {
+      next_index_ = job_count_;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_)
+        error_ = std::current_exception();
+    }
+    InsideTask() = false;
+  }
+
+  void WorkerLoop()
+  {
+    std::size_t seen_generation = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&]{ return stop_ || generation_ != seen_generation; });
+        if (stop_)
+          return;
+        seen_generation = generation_;
+      }
+
+      RunJob();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --busy_workers_;
+      }
+      done_.notify_one();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+
+  /// Serializes ParallelFor calls
+  std::mutex job_mutex_;
+
+  /// Guards the job description and the counters below
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::function<void(std::size_t)> job_;
+  std::size_t job_count_;
+  std::atomic<std::size_t> next_index_;
+  std::size_t busy_workers_;
+  std::size_t generation_;
+  bool stop_;
+  /// First exception thrown by a task of the current job
+  std::exception_ptr error_;
+};
+
+
+#endif  // THREADPOOL_H
+
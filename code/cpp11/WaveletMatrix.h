@@ -0,0 +1,172 @@
+/**
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015 Nikolaus Mayer
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WAVELETMATRIX_H
+#define WAVELETMATRIX_H
+
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint64_t
+#include <vector>
+
+
+/**
+ * A sequence of integers which answers "how many values in positions
+ * [begin, end) are less than c" in O(log(max value)) time
+ *
+ * The wavelet matrix (Claude, Navarro and Ordonez) stores one bit
+ * vector per bit of the values, most significant first. Level l holds
+ * bit l of every value, in the order the values have after being
+ * stably partitioned by all higher bits (zeros first); so a range of
+ * positions maps to one range per level, found with two rank
+ * operations. Every bit vector stores, per 64-bit word, the number of
+ * ones before it, so that a rank is one lookup plus one popcount.
+ *
+ * Memory is 2 bits per value and level (the words and their ranks);
+ * values below n need ceil(log2 n) levels.
+ */
+class WaveletMatrix {
+public:
+  WaveletMatrix()
+  : size_{0}
+  { }
+
+  /// Build over "values" (which is used up)
+  explicit WaveletMatrix(std::vector<std::size_t> values)
+  : size_{values.size()}
+  {
+    std::size_t largest = 0;
+    for (std::size_t value: values)
+      if (value > largest)
+        largest = value;
+    unsigned bits = 0;
+    while (bits < 64 && (largest >> bits) != 0)
+      ++bits;
+
+    levels_.resize(bits);
+    std::vector<std::size_t> ones;
+    for (unsigned level = bits; level-- > 0; )
+    {
+      Level& current = levels_[bits - 1 - level];
+      current.words.resize(size_ / 64 + 1, Word{0, 0});
+      std::size_t zeros = 0;
+      ones.clear();
+      for (std::size_t i = 0; i < size_; ++i)
+      {
+        if ((values[i] >> level) & 1)
+        {
+          current.words[i / 64].bits |= std::uint64_t(1) << (i % 64);
+          ones.push_back(values[i]);
+        }
+        else
+          values[zeros++] = values[i];
+      }
+      std::uint64_t rank = 0;
+      for (Word& word: current.words)
+      {
+        word.rank = rank;
+        rank += __builtin_popcountll(word.bits);
+      }
+      current.zeros = zeros;
+      /// Stable partition: zeros first, then ones
+      for (std::size_t i = 0; i < ones.size(); ++i)
+        values[zeros + i] = ones[i];
+    }
+  }
+
+  std::size_t size() const { return size_; }
+
+  /**
+   * Number of positions i in [begin, end) whose value is less than
+   * "value"
+   */
+  std::size_t CountLess(std::size_t begin, std::size_t end,
+                        std::size_t value) const
+  {
+    if (begin >= end)
+      return 0;
+    const unsigned bits = static_cast<unsigned>(levels_.size());
+    if (bits < 64 && (value >> bits) != 0)
+      return end - begin;
+
+    std::size_t less = 0;
+    for (unsigned l = 0; l < bits; ++l)
+    {
+      const Level& level = levels_[l];
+      const std::size_t zeros_begin = begin - Rank1(level, begin);
+      const std::size_t zeros_end = end - Rank1(level, end);
+      if ((value >> (bits - 1 - l)) & 1)
+      {
+        /// Values with a 0 here are less; go on with those with a 1
+        less += zeros_end - zeros_begin;
+        begin = level.zeros + (begin - zeros_begin);
+        end = level.zeros + (end - zeros_end);
+      }
+      else
+      {
+        begin = zeros_begin;
+        end = zeros_end;
+      }
+      if (begin == end)
+        break;
+    }
+    return less;
+  }
+
+  /// Number of positions i in [begin, end) with low <= value < high
+  std::size_t CountBetween(std::size_t begin, std::size_t end,
+                           std::size_t low, std::size_t high) const
+  {
+    if (low >= high)
+      return 0;
+    return CountLess(begin, end, high) - CountLess(begin, end, low);
+  }
+
+private:
+  /// 64 bits of a level, and the number of ones before them
+  struct Word {
+    std::uint64_t rank;
+    std::uint64_t bits;
+  };
+
+  struct Level {
+    std::vector<Word> words;
+    /// Number of zeros in this level
+    std::size_t zeros;
+  };
+
+  /// Number of ones in positions [0, i) of "level"
+  static std::size_t Rank1(const Level& level, std::size_t i)
+  {
+    const Word& word = level.words[i / 64];
+    const std::uint64_t below = (std::uint64_t(1) << (i % 64)) - 1;
+    return static_cast<std::size_t>(
+             word.rank + __builtin_popcountll(word.bits & below));
+  }
+
+  std::size_t size_;
+  std::vector<Level> levels_;
+};
+
+
+#endif  // WAVELETMATRIX_H
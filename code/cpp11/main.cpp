@@ -23,11 +23,18 @@
  */
 
 
+#include <algorithm> // std::min
+#include <cctype>    // std::isdigit
+#include <cerrno>    // errno, ERANGE
 #include <cmath>     // std::fabs
-#include <cstdlib>   // EXIT_SUCCESS
+#include <cstdint>   // std::uint64_t
+#include <cstdio>    // std::FILE, std::fopen, stdin
+#include <cstdlib>   // EXIT_SUCCESS, std::strtof, std::strtoull
+#include <cstring>   // std::strcmp
 #include <iostream>
 #include <limits>    // std::numeric_limits
 #include <memory>
+#include <stdexcept> // std::runtime_error
 #include <type_traits>
 #include <vector>
 #if __cplusplus > 199711L
@@ -36,6 +43,30 @@
   #include <ctime>
 #endif
 
+#include <fcntl.h>     // open
+#include <unistd.h>    // close, STDOUT_FILENO
+
+#include "GridIndex.h"
+#include "HalfFloat.h"
+#include "KdTree.h"
+#include "L1BallIndex.h"
+#include "Log.h"
+#include "NearestK.h"
+#include "ObservablePointSet.h"
+#include "ParallelQueries.h"
+#include "PointCloud2d.h"
+#include "PointFile.h"
+#include "PointStream.h"
+#include "PointWriter.h"
+#include "Quadtree.h"
+#include "QuantizedPointCloud2d.h"
+#include "RngContext.h"
+#include "ScanEngine.h"
+#include "SimdRandom.h"
+#include "SlidingWindow.h"
+#include "SortedDistanceIndex.h"
+#include "TaskScheduler.h"
+
 
 /**
  * Generate a uniformly random number in [-1, +1]
@@ -46,14 +77,14 @@
 float RandomNumber()
 {
   #if __cplusplus > 199711L
-    /// Raw randomness
-    static std::random_device randdev;
-    /// Mersenne Twister engine for high quality randomness
-    static std::mt19937 mersenne(randdev());
+    /// Every thread draws from its own engine, a stream of the global
+    /// context; seed that with GlobalRngContext().Reseed() to make runs
+    /// reproducible (see RngContext.h)
+    RngStream& engine = GlobalRngContext().ThreadStream();
     /// Uniform distribution [-1, +1]
-    static std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    static thread_local std::uniform_real_distribution<float> uniform(-1.f, 1.f);
 
-    return uniform(mersenne);
+    return uniform(engine);
   #else
     /// Seed PRNG on first run
     static bool firstrun=true;
@@ -74,25 +105,34 @@ float RandomNumber()
 
 /**
  * A point in 2d space
+ *
+ * T is the storage type of the coordinates: float, double, or one of
+ * the 16-bit Float16 / BFloat16 (see HalfFloat.h). Distances are
+ * computed in ComputeType<T>, i.e. in float for the 16-bit types.
  */
 template <typename T>
 struct Pos2d {
-  Pos2d(float x, float y) 
+  Pos2d(T x, T y) 
   : x{x}, y{y} 
   {
-    static_assert(std::is_floating_point<T>::value,
+    static_assert(IsStorageFloat<T>::value,
                   "'Pos2d' class only works for float types!'");
   }
-  float x;
-  float y;
+  T x;
+  T y;
 };
-typedef std::shared_ptr<Pos2d<float>> Pos2d_ptr;
-typedef std::shared_ptr<const Pos2d<float>> Pos2d_cptr;
+template <typename T>
+using Pos2dPtr = std::shared_ptr<Pos2d<T>>;
+template <typename T>
+using Pos2dCPtr = std::shared_ptr<const Pos2d<T>>;
+typedef Pos2dPtr<float> Pos2d_ptr;
+typedef Pos2dCPtr<float> Pos2d_cptr;
 
 template <typename T>
 std::ostream& operator<<(std::ostream& os, const Pos2d<T>& point)
 {
-  os << "(" << point.x << ", " << point.y << ")";
+  typedef typename ComputeType<T>::type Compute;
+  os << "(" << Compute(point.x) << ", " << Compute(point.y) << ")";
   return os;
 }
 
@@ -101,27 +141,77 @@ std::ostream& operator<<(std::ostream& os, const Pos2d<T>& point)
  * Generate a Pos2d with x and y coordinates uniformly i.i.d.
  * in [-1, +1]
  */
-Pos2d_ptr RandomPos2d()
+template <typename T = float>
+Pos2dPtr<T> RandomPos2d()
 {
-  auto new_point = std::make_shared<Pos2d<float>>(RandomNumber(), RandomNumber());
-  std::cout << "New point " << *new_point << " created\n";
+  auto new_point = std::make_shared<Pos2d<T>>(RandomNumber(), RandomNumber());
+  /// Sampled, and compiled out below LOG_LEVEL_DEBUG (see Log.h)
+  LOG_EVERY_N(DEBUG, 1000) << "New point " << *new_point << " created";
   return new_point;
 }
 
 
-float ManhattanToOrigin(Pos2d_cptr point)
+/**
+ * Fill "points" with "count" points whose x and y coordinates are
+ * uniformly i.i.d. in [-1, +1), generated in parallel on "scheduler".
+ *
+ * Every chunk of kParallelChunkSize points gets two SIMD generators of
+ * its own, streams 2*chunk (x) and 2*chunk+1 (y) of "seed". The chunk
+ * boundaries are fixed, so the data set depends only on "seed", not on
+ * the number of threads or on which thread generates which chunk.
+ */
+void RandomPos2d(TaskScheduler& scheduler, PointCloud2d& points,
+                 std::size_t count, std::uint64_t seed)
+{
+  points.resize(count);
+  ParallelForRange(scheduler, 0, ParallelChunkCount(count), 1,
+    [&](std::size_t first_chunk, std::size_t last_chunk) {
+      for (std::size_t chunk = first_chunk; chunk < last_chunk; ++chunk)
+      {
+        const std::size_t begin = chunk * kParallelChunkSize;
+        const std::size_t end = std::min(begin + kParallelChunkSize, count);
+        UniformFloatGenerator(seed, 2*chunk).Fill(points.x_data() + begin,
+                                                  end - begin);
+        UniformFloatGenerator(seed, 2*chunk+1).Fill(points.y_data() + begin,
+                                                    end - begin);
+      }
+    });
+  LOG(DEBUG) << "Generated " << count << " points from seed " << seed;
+}
+
+
+template <typename T>
+typename ComputeType<T>::type ManhattanToOrigin(const Pos2d<T>& point)
+{
+  typedef typename ComputeType<T>::type Compute;
+  return std::abs(Compute(point.x)) + std::abs(Compute(point.y));
+}
+
+/// Same for a Pos2dPtr<T> or Pos2dCPtr<T>
+template <typename Pos>
+auto ManhattanToOrigin(const std::shared_ptr<Pos>& point)
+  -> decltype(ManhattanToOrigin(*point))
+{
+  return ManhattanToOrigin(*point);
+}
+
+
+template <typename T>
+bool Pos2dIsNearOrigin(const Pos2d<T>& point)
 {
-  return std::abs(point->x) + std::abs(point->y);
+  return (ManhattanToOrigin(point) < 0.5f);
 }
 
 
 
-std::tuple<Pos2d_cptr, float> NearestToOrigin(
-                          const std::vector<Pos2d_ptr>& points
-                                             )
+template <typename T>
+std::tuple<Pos2dCPtr<T>, typename ComputeType<T>::type> NearestToOrigin(
+                          const std::vector<Pos2dPtr<T>>& points
+                                                                       )
 {
-  Pos2d_cptr min_point{nullptr};
-  float min_distance = std::numeric_limits<float>::max();
+  typedef typename ComputeType<T>::type Compute;
+  Pos2dCPtr<T> min_point{nullptr};
+  Compute min_distance = std::numeric_limits<Compute>::max();
   for (auto point: points)
   {
     if (ManhattanToOrigin(point) < min_distance)
@@ -135,30 +225,642 @@ std::tuple<Pos2d_cptr, float> NearestToOrigin(
 }
 
 
-int main()
+/**
+ * Print how many of "points" are near the origin and which one is
+ * nearest; "points" is a PointCloud2d or a MappedPointCloud2d
+ */
+template <typename Points>
+void ReportNearOrigin(TaskScheduler& scheduler, const Points& points)
 {
-  std::vector<Pos2d_ptr> points;
-  for (auto i = 0; i < 100; ++i)
-    points.push_back(RandomPos2d());
+  /// Count and nearest point in a single, multithreaded pass
+  /// (see ScanEngine.h and ParallelQueries.h)
+  CountBelow nearOrigin(0.5f);
+  ArgMinDistance nearest;
+  Scan(scheduler, points, nearOrigin, nearest);
 
-  auto Pos2dIsNearOrigin = [](Pos2d_cptr point) -> bool {
-    return (ManhattanToOrigin(point) < 0.5f);
-  };
+  std::cout << nearOrigin.count << " of " << points.size() 
+            << " points are near the origin.\n";
+  if (nearest.index >= points.size())
+    return;
 
+  std::cout << "The nearest point was " 
+            << Pos2d<float>(points.x(nearest.index), points.y(nearest.index))
+            << " with distance " << nearest.distance << "\n";
+}
+
+
+/// Storage types of the coordinates for "--precision"
+enum class Precision { kFloat, kDouble, kHalf, kBFloat16 };
+
+
+/**
+ * The Precision named "name" ("double", "half" or "bfloat16"); false
+ * for other names
+ */
+bool ParsePrecision(const char* name, Precision& precision)
+{
+  if (std::strcmp(name, "double") == 0)
+    precision = Precision::kDouble;
+  else if (std::strcmp(name, "half") == 0)
+    precision = Precision::kHalf;
+  else if (std::strcmp(name, "bfloat16") == 0)
+    precision = Precision::kBFloat16;
+  else
+    return false;
+  return true;
+}
+
+
+/**
+ * The near-origin report for "points" with 16-bit coordinates of type
+ * T (see HalfFloat.h), which the SIMD kernels scan at half the memory
+ * traffic
+ */
+template <typename T, typename Points>
+void ReportNearOriginAs(TaskScheduler& scheduler, const Points& points)
+{
+  BasicPointCloud2d<T> converted(points.size());
+  for (std::size_t i = 0; i < points.size(); ++i)
+  {
+    converted.x(i) = T(points.x(i));
+    converted.y(i) = T(points.y(i));
+  }
+
+  std::cout << CountNearOrigin(scheduler, converted) << " of "
+            << converted.size() << " points are near the origin.\n";
+  const auto nearest = NearestToOrigin(scheduler, converted);
+  if (std::get<0>(nearest) >= converted.size())
+    return;
+
+  std::cout << "The nearest point was "
+            << Pos2d<T>(converted.x(std::get<0>(nearest)),
+                        converted.y(std::get<0>(nearest)))
+            << " with distance " << std::get<1>(nearest) << "\n";
+}
+
+
+/**
+ * The near-origin report for "points" as Pos2d<double> objects, with
+ * the distances computed in double
+ */
+template <typename Points>
+void ReportNearOriginAsDouble(const Points& points)
+{
+  std::vector<Pos2dPtr<double>> converted;
+  converted.reserve(points.size());
+  for (std::size_t i = 0; i < points.size(); ++i)
+    converted.push_back(std::make_shared<Pos2d<double>>(points.x(i),
+                                                        points.y(i)));
+  const std::size_t nearOrigin = std::count_if(converted.begin(),
+                                               converted.end(),
+    [](const Pos2dPtr<double>& point) { return Pos2dIsNearOrigin(*point); });
+
+  std::cout << nearOrigin << " of " << points.size()
+            << " points are near the origin.\n";
+  const auto nearest = NearestToOrigin(converted);
+  if (!std::get<0>(nearest))
+    return;
+
+  std::cout << "The nearest point was " << *std::get<0>(nearest)
+            << " with distance " << std::get<1>(nearest) << "\n";
+}
+
+
+/**
+ * Repeat the near-origin report with the coordinates of "points"
+ * stored as "precision" (rounded to it first, so near the threshold
+ * the answers may differ from those in float)
+ */
+template <typename Points>
+void ReportPrecision(TaskScheduler& scheduler, const Points& points,
+                     Precision precision)
+{
+  switch (precision)
+  {
+    case Precision::kFloat:
+      return;
+    case Precision::kDouble:
+      std::cout << "With double coordinates:\n";
+      ReportNearOriginAsDouble(points);
+      return;
+    case Precision::kHalf:
+      std::cout << "With half coordinates:\n";
+      ReportNearOriginAs<Float16>(scheduler, points);
+      return;
+    case Precision::kBFloat16:
+      std::cout << "With bfloat16 coordinates:\n";
+      ReportNearOriginAs<BFloat16>(scheduler, points);
+      return;
+  }
+}
+
+
+/**
+ * Print how many of "points" are nearer to the origin than "threshold"
+ * under "Metric" (see Metrics.h), and the nearest distance
+ */
+template <typename Metric, typename Points>
+void ReportMetric(TaskScheduler& scheduler, const Points& points,
+                  const char* name, float threshold)
+{
+  CountBelow nearOrigin(threshold);
+  ArgMinDistance nearest;
+  Scan<Metric>(scheduler, points, nearOrigin, nearest);
+  std::cout << "  " << name << ": " << nearOrigin.count << " near";
+  if (nearest.index < points.size())
+    std::cout << ", nearest distance " << nearest.distance;
+  std::cout << "\n";
+}
+
+
+/**
+ * Print the near-origin count and nearest distance under each metric;
+ * the squared Euclidean distance is compared to the squared threshold
+ */
+template <typename Points>
+void ReportMetrics(TaskScheduler& scheduler, const Points& points)
+{
+  std::cout << "By metric (threshold 0.5):\n";
+  ReportMetric<L1Metric>(scheduler, points, "L1", 0.5f);
+  ReportMetric<L2Metric>(scheduler, points, "L2", 0.5f);
+  ReportMetric<SquaredL2Metric>(scheduler, points, "squared L2", 0.25f);
+  ReportMetric<ChebyshevMetric>(scheduler, points, "Chebyshev", 0.5f);
+}
+
+
+/**
+ * Print the k points of "points" nearest to the origin, nearest first
+ */
+template <typename Points>
+void ReportNearestK(TaskScheduler& scheduler, const Points& points,
+                    std::size_t k)
+{
+  const std::vector<Neighbor> nearest = NearestKToOrigin(scheduler, points, k);
+  std::cout << "The " << nearest.size() << " nearest points:\n";
+  for (const Neighbor& neighbor: nearest)
+    std::cout << "  #" << neighbor.index << " "
+              << Pos2d<float>(points.x(neighbor.index),
+                              points.y(neighbor.index))
+              << " with distance " << neighbor.distance << "\n";
+}
+
+
+/**
+ * Print the point of "points" nearest to (qx, qy), found with a k-d
+ * tree (see KdTree.h)
+ */
+template <typename Points>
+void ReportNearestTo(TaskScheduler& scheduler, const Points& points,
+                     float qx, float qy)
+{
+  const KdTree2d tree(scheduler, points);
+  const Neighbor nearest = tree.Nearest(qx, qy);
+  if (nearest.index >= points.size())
+    return;
+  std::cout << "The nearest point to " << Pos2d<float>(qx, qy) << " was "
+            << Pos2d<float>(points.x(nearest.index), points.y(nearest.index))
+            << " with distance " << nearest.distance << "\n";
+}
+
+
+/**
+ * Print how many of "points" are within L1 distance "radius" of
+ * (qx, qy), counted with a uniform grid (see GridIndex.h)
+ */
+template <typename Points>
+void ReportWithin(const Points& points, float qx, float qy, float radius)
+{
+  const GridIndex2d grid(points);
+  std::cout << grid.CountWithin(qx, qy, radius) << " of " << points.size()
+            << " points are within distance " << radius << " of "
+            << Pos2d<float>(qx, qy) << ".\n";
+}
+
+
+/**
+ * Print the average number of "points" within L1 distance "radius"
+ * of each of the first "centres" points, from one rotated-coordinate
+ * index (see L1BallIndex.h)
+ */
+template <typename Points>
+void ReportCentres(const Points& points, std::size_t centres, float radius)
+{
+  const L1BallIndex index(points);
+  centres = std::min(centres, points.size());
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < centres; ++i)
+    total += index.CountWithin(points.x(i), points.y(i), radius);
+  if (centres > 0)
+    std::cout << "On average " << double(total) / centres
+              << " points are within distance " << radius << " of the first "
+              << centres << " points.\n";
+}
 
-  int nearOrigin = 0;
-  for (auto point: points)
-    if (Pos2dIsNearOrigin(point))
-      ++nearOrigin;
 
-  std::cout << nearOrigin << " of " << points.size() 
+/**
+ * Move "updates" random points of "points" to random positions in a
+ * dynamic quadtree (see Quadtree.h) and in a set which tracks its
+ * near-origin count and nearest point (see ObservablePointSet.h), and
+ * print both afterwards; neither rescans the points
+ */
+template <typename Points>
+void ReportUpdates(const Points& points, std::size_t updates)
+{
+  if (points.size() == 0)
+    return;
+  Quadtree2d tree(points);
+  ObservablePointSet tracked(points);
+  RngStream& engine = GlobalRngContext().ThreadStream();
+  for (std::size_t update = 0; update < updates; ++update)
+  {
+    const std::size_t id = engine() % points.size();
+    const float x = engine.Uniform();
+    const float y = engine.Uniform();
+    tree.Move(id, x, y);
+    tracked.Set(id, x, y);
+  }
+  std::cout << "After " << updates << " random moves, "
+            << CountNearOrigin(tree) << " of " << tree.size()
             << " points are near the origin.\n";
+  const Neighbor nearest = tree.Nearest(0.f, 0.f);
+  if (nearest.index != Quadtree2d::kNoId)
+    std::cout << "The nearest point was "
+              << Pos2d<float>(tree.x(nearest.index), tree.y(nearest.index))
+              << " with distance " << nearest.distance << "\n";
+  std::cout << "Tracked incrementally: " << tracked.CountNear()
+            << " near, nearest distance " << tracked.Nearest().distance
+            << "\n";
+}
+
 
-  Pos2d_cptr nearest_point;
-  float min_distance;
-  std::tie(nearest_point, min_distance) = NearestToOrigin(points);
-  std::cout << "The nearest point was " << *nearest_point
-            << " with distance " << min_distance << "\n";
+/**
+ * Print the near-origin counts of "points" for "steps" thresholds
+ * evenly spaced in (0, 2], from one sorted index of the distances
+ * (see SortedDistanceIndex.h)
+ */
+template <typename Points>
+void ReportSweep(TaskScheduler& scheduler, const Points& points,
+                 std::size_t steps)
+{
+  const SortedDistanceIndex index(scheduler, points);
+  std::cout << "Points nearer to the origin than:\n";
+  for (std::size_t step = 1; step <= steps; ++step)
+  {
+    const float threshold = 2.f * step / steps;
+    std::cout << "  " << threshold << ": "
+              << CountNearOrigin(index, threshold) << "\n";
+  }
+}
+
+
+/**
+ * Open the file "path" ("-" for stdout) for text output of points;
+ * returns -1 (after printing the reason) on errors
+ */
+int OpenDumpFile(const char* path)
+{
+  if (std::strcmp(path, "-") == 0)
+  {
+    /// Keep the order of what std::cout has buffered so far
+    std::cout.flush();
+    return STDOUT_FILENO;
+  }
+  const int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    std::cerr << "Cannot open '" << path << "'\n";
+  return fd;
+}
+
+void CloseDumpFile(int fd)
+{
+  if (fd != STDOUT_FILENO)
+    ::close(fd);
+}
+
+
+/**
+ * Write "points" as text lines "x y" to the file "path" ("-" for
+ * stdout); see PointWriter.h. Up to one chunk of points goes through
+ * a PointTextWriter, more are formatted in parallel. Returns false
+ * (after printing the reason) on errors.
+ */
+template <typename Points>
+bool DumpPoints(TaskScheduler& scheduler, const Points& points,
+                const char* path)
+{
+  const int fd = OpenDumpFile(path);
+  if (fd < 0)
+    return false;
+  bool written = true;
+  try
+  {
+    if (points.size() <= kParallelChunkSize)
+    {
+      PointTextWriter writer(fd);
+      writer.Write(points);
+      writer.Flush();
+    }
+    else
+      WritePointsText(scheduler, fd, points);
+  }
+  catch (const std::runtime_error& error)
+  {
+    std::cerr << error.what() << "\n";
+    written = false;
+  }
+  CloseDumpFile(fd);
+  return written;
+}
+
+
+/**
+ * A Scan() aggregate which passes the blocks on to "*aggregate", or
+ * ignores them if that is null, for aggregates chosen at run time
+ */
+template <typename Aggregate>
+struct OptionalAggregate {
+  Aggregate* aggregate;
+
+  void Consume(const ScanBlock& block)
+  {
+    if (aggregate)
+      aggregate->Consume(block);
+  }
+};
+
+
+/**
+ * Parse "text" as a decimal number without a sign into "value"; false
+ * if it is not one (e.g. "abc", "-1" or "12x") or too large for
+ * Unsigned
+ */
+template <typename Unsigned>
+bool ParseUnsigned(const char* text, Unsigned& value)
+{
+  /// std::strtoull would skip spaces, and accept (and wrap) a minus
+  if (!std::isdigit(static_cast<unsigned char>(text[0])))
+    return false;
+  errno = 0;
+  char* end = nullptr;
+  const unsigned long long parsed = std::strtoull(text, &end, 10);
+  if (errno == ERANGE || *end != '\0' ||
+      parsed > std::numeric_limits<Unsigned>::max())
+    return false;
+  value = static_cast<Unsigned>(parsed);
+  return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+  /// "--seed N" replays the run that printed "Random seed: N";
+  /// "--save FILE" writes the generated points to a point file, and
+  /// "--load FILE" queries a point file instead (see PointFile.h);
+  /// "--stream FILE" reads "x y" text lines ("-" for stdin) chunk by
+  /// chunk, in constant memory (see PointStream.h), and "--window N"
+  /// also reports on its last N points; "--dump FILE" writes the
+  /// generated, loaded or streamed points as text ("-" for stdout);
+  /// "--nearest K" also lists the K points nearest to the origin,
+  /// "--query X Y" finds the point nearest to (X, Y), and "--within R"
+  /// counts the points within distance R of it (or of the origin);
+  /// "--centres N" counts them around each of the first N points
+  /// instead; "--sweep N" prints the near-origin counts for N
+  /// thresholds; "--updates N" repeats the queries after moving N
+  /// random points; "--metrics" repeats the near-origin query under
+  /// each distance metric, and "--precision P" with the coordinates
+  /// stored as double, half or bfloat16
+  const char* load_path = nullptr;
+  const char* dump_path = nullptr;
+  const char* stream_path = nullptr;
+  const char* save_path = nullptr;
+  std::size_t nearest_k = 0;
+  bool query = false;
+  float query_x = 0.f;
+  float query_y = 0.f;
+  float within = 0.f;
+  std::size_t centres = 0;
+  std::size_t sweep_steps = 0;
+  std::size_t updates = 0;
+  std::size_t window_points = 0;
+  bool metrics = false;
+  Precision precision = Precision::kFloat;
+  bool verify = false;
+  for (int arg = 1; arg < argc; ++arg)
+  {
+    bool valid = true;
+    if (std::strcmp(argv[arg], "--seed") == 0 && arg+1 < argc)
+    {
+      std::uint64_t seed = 0;
+      valid = ParseUnsigned(argv[++arg], seed);
+      GlobalRngContext().Reseed(seed);
+    }
+    else if (std::strcmp(argv[arg], "--load") == 0 && arg+1 < argc)
+      load_path = argv[++arg];
+    else if (std::strcmp(argv[arg], "--save") == 0 && arg+1 < argc)
+      save_path = argv[++arg];
+    else if (std::strcmp(argv[arg], "--stream") == 0 && arg+1 < argc)
+      stream_path = argv[++arg];
+    else if (std::strcmp(argv[arg], "--dump") == 0 && arg+1 < argc)
+      dump_path = argv[++arg];
+    else if (std::strcmp(argv[arg], "--nearest") == 0 && arg+1 < argc)
+      valid = ParseUnsigned(argv[++arg], nearest_k);
+    else if (std::strcmp(argv[arg], "--query") == 0 && arg+2 < argc)
+    {
+      query = true;
+      query_x = std::strtof(argv[++arg], nullptr);
+      query_y = std::strtof(argv[++arg], nullptr);
+    }
+    else if (std::strcmp(argv[arg], "--within") == 0 && arg+1 < argc)
+      within = std::strtof(argv[++arg], nullptr);
+    else if (std::strcmp(argv[arg], "--centres") == 0 && arg+1 < argc)
+      valid = ParseUnsigned(argv[++arg], centres);
+    else if (std::strcmp(argv[arg], "--sweep") == 0 && arg+1 < argc)
+      valid = ParseUnsigned(argv[++arg], sweep_steps);
+    else if (std::strcmp(argv[arg], "--updates") == 0 && arg+1 < argc)
+      valid = ParseUnsigned(argv[++arg], updates);
+    else if (std::strcmp(argv[arg], "--window") == 0 && arg+1 < argc)
+      valid = ParseUnsigned(argv[++arg], window_points);
+    else if (std::strcmp(argv[arg], "--metrics") == 0)
+      metrics = true;
+    else if (std::strcmp(argv[arg], "--precision") == 0 && arg+1 < argc)
+      valid = ParsePrecision(argv[++arg], precision);
+    else if (std::strcmp(argv[arg], "--verify") == 0)
+      verify = true;
+    else
+      valid = false;
+    if (!valid)
+    {
+      std::cerr << "Usage: " << argv[0]
+                << " [--seed N] [--save FILE] [OPTIONS]\n"
+                << "       " << argv[0]
+                << " --load FILE [--verify] [OPTIONS]\n"
+                << "       " << argv[0]
+                << " --stream FILE|- [--window N] [--dump FILE|-]\n"
+                << "OPTIONS: [--dump FILE|-] [--nearest K] [--query X Y]"
+                << " [--within R] [--centres N] [--sweep N]"
+                << " [--updates N] [--metrics]"
+                << " [--precision double|half|bfloat16]\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  /// Work-stealing worker threads, one per core (see TaskScheduler.h)
+  TaskScheduler scheduler;
+
+  if (stream_path)
+  {
+    std::FILE* input = (std::strcmp(stream_path, "-") == 0)
+                       ? stdin : std::fopen(stream_path, "r");
+    if (!input)
+    {
+      std::cerr << "Cannot open '" << stream_path << "'\n";
+      return EXIT_FAILURE;
+    }
+    const int dump_fd = dump_path ? OpenDumpFile(dump_path) : -1;
+    if (dump_path && dump_fd < 0)
+    {
+      if (input != stdin)
+        std::fclose(input);
+      return EXIT_FAILURE;
+    }
+    CountBelow nearOrigin(0.5f);
+    NearestPoint nearest;
+    /// The last "window_points" points (see SlidingWindow.h), only
+    /// scanned with --window, and the points written back as text
+    /// while they stream by, only with --dump
+    SlidingWindow window(window_points);
+    OptionalAggregate<SlidingWindow> windowed{window_points > 0 ? &window
+                                                                : nullptr};
+    std::unique_ptr<PointTextWriter> dump;
+    if (dump_path)
+      dump.reset(new PointTextWriter(dump_fd));
+    OptionalAggregate<PointTextWriter> dumped{dump.get()};
+    const auto close_files = [&] {
+      /// The writer flushes what it still holds before its file closes
+      dump.reset();
+      if (dump_path)
+        CloseDumpFile(dump_fd);
+      if (input != stdin)
+        std::fclose(input);
+    };
+    std::size_t count = 0;
+    try
+    {
+      count = ScanStream(input, nearOrigin, nearest, windowed, dumped);
+      if (dump)
+        dump->Flush();
+    }
+    catch (const std::runtime_error& error)
+    {
+      std::cerr << error.what() << "\n";
+      close_files();
+      return EXIT_FAILURE;
+    }
+    close_files();
+
+    std::cout << nearOrigin.count << " of " << count
+              << " points are near the origin.\n";
+    if (count > 0)
+      std::cout << "The nearest point was "
+                << Pos2d<float>(nearest.x, nearest.y)
+                << " with distance " << nearest.nearest.distance << "\n";
+    if (window_points > 0)
+    {
+      std::cout << "Of the last " << window.size() << " points, "
+                << window.CountNear() << " are near the origin.\n";
+      const Neighbor window_nearest = window.Nearest();
+      if (window_nearest.index < window.arrivals())
+        std::cout << "The nearest of them was "
+                  << Pos2d<float>(window.x(window_nearest.index),
+                                  window.y(window_nearest.index))
+                  << " with distance " << window_nearest.distance << "\n";
+    }
+  }
+  else if (load_path)
+  {
+    try
+    {
+      /// The file is used in place; nothing is parsed or copied
+      const MappedPointCloud2d points(load_path);
+      if (verify && !points.VerifyChecksum())
+      {
+        std::cerr << "Point file '" << load_path << "': wrong checksum\n";
+        return EXIT_FAILURE;
+      }
+      if (dump_path && !DumpPoints(scheduler, points, dump_path))
+        return EXIT_FAILURE;
+      ReportNearOrigin(scheduler, points);
+      if (metrics)
+        ReportMetrics(scheduler, points);
+      ReportPrecision(scheduler, points, precision);
+      if (nearest_k > 0)
+        ReportNearestK(scheduler, points, nearest_k);
+      if (query)
+        ReportNearestTo(scheduler, points, query_x, query_y);
+      if (centres > 0)
+        ReportCentres(points, centres, within > 0.f ? within : 0.5f);
+      else if (within > 0.f)
+        ReportWithin(points, query_x, query_y, within);
+      if (sweep_steps > 0)
+        ReportSweep(scheduler, points, sweep_steps);
+      if (updates > 0)
+        ReportUpdates(points, updates);
+    }
+    catch (const std::runtime_error& error)
+    {
+      std::cerr << error.what() << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+  else
+  {
+    const auto seed = GlobalRngContext().seed();
+    std::cout << "Random seed: " << seed << "\n";
+
+    /// Points are stored as two flat coordinate arrays instead of one
+    /// heap object per point (see PointCloud2d.h), and generated in
+    /// parallel
+    PointCloud2d points;
+    RandomPos2d(scheduler, points, 100, seed);
+    if (save_path)
+    {
+      try
+      {
+        WritePointFile(save_path, points);
+      }
+      catch (const std::runtime_error& error)
+      {
+        std::cerr << error.what() << "\n";
+        return EXIT_FAILURE;
+      }
+    }
+    if (dump_path && !DumpPoints(scheduler, points, dump_path))
+      return EXIT_FAILURE;
+    ReportNearOrigin(scheduler, points);
+    if (metrics)
+      ReportMetrics(scheduler, points);
+    ReportPrecision(scheduler, points, precision);
+    if (nearest_k > 0)
+      ReportNearestK(scheduler, points, nearest_k);
+    if (query)
+      ReportNearestTo(scheduler, points, query_x, query_y);
+    if (centres > 0)
+      ReportCentres(points, centres, within > 0.f ? within : 0.5f);
+    else if (within > 0.f)
+      ReportWithin(points, query_x, query_y, within);
+    if (sweep_steps > 0)
+      ReportSweep(scheduler, points, sweep_steps);
+    if (updates > 0)
+      ReportUpdates(points, updates);
+
+    /// The same queries on int16 fixed-point coordinates, at half the
+    /// memory of "points" (see QuantizedPointCloud2d.h)
+    const QuantizedPointCloud2d quantized(points);
+    std::cout << "Quantized to int16 (L1 error at most "
+              << QuantizedPointCloud2d::kMaxDistanceError << "): "
+              << CountNearOrigin(quantized) << " near, nearest distance "
+              << std::get<1>(NearestToOrigin(quantized)) << "\n";
+  }
 
 
   #if __cplusplus > 199711L
@@ -166,6 +868,7 @@ int main()
   #else
     std::cout << "Compiled using C++03 or earlier\n";
   #endif
+  std::cout << "SIMD kernels use " << simd::kName << "\n";
 
   return EXIT_SUCCESS;
 }